@@ -36,40 +36,47 @@
 
 class Sigmoid {
  public:
-  double operator()(double x) {
-    return (1.0 / (1.0 + exp(-x)));
+  template<typename T>
+  T operator()(T x) {
+    return (T(1) / (T(1) + std::exp(-x)));
   }
 
-  double deriv(double x) {
-    return x * (1.0 - x);
+  template<typename T>
+  T deriv(T x) {
+    return x * (T(1) - x);
   }
 };
 
 class TanH {
  public:
-  double operator()(double x) {
-    return tanh(x);
+  template<typename T>
+  T operator()(T x) {
+    return std::tanh(x);
   }
 
-  double deriv(double x) {
-    return (1.0 - x * x);
+  template<typename T>
+  T deriv(T x) {
+    return (T(1) - x * x);
   }
 };
 
 class Linear {
  public:
-  double operator()(double x) {
+  template<typename T>
+  T operator()(T x) {
     return x;
   }
 
-  double deriv(double x) {
-    return 1.0;
+  template<typename T>
+  T deriv(T x) {
+    return T(1);
   }
 };
 
 class LinearSaturated {
  public:
-  double operator()(double x) {
+  template<typename T>
+  T operator()(T x) {
     if(x >= 1)
       return 1;
     else if(x <= -1)
@@ -78,26 +85,29 @@ class LinearSaturated {
       return (x + 1) / 2;
   }
 
-  double deriv(double x) {
+  template<typename T>
+  T deriv(T x) {
     if(x > 1 || x < -1)
       return 0;
     else
-      return .5;
+      return T(.5);
   }
 };
 
 class ReLU {
  public:
-  double operator()(double x) {
+  template<typename T>
+  T operator()(T x) {
     if(x>=0)
       return x;
     else
       return 0;
   }
 
-  double deriv(double x) {
+  template<typename T>
+  T deriv(T x) {
     if(x>=0)
-      return 1.0;
+      return T(1);
     else
       return 0;
   }
@@ -105,14 +115,15 @@ class ReLU {
 
 // We can now define templatized functions
 // to evaluate and derivate the unit activation functions.
+// The scalar type (float or double) is that of the argument.
 
-template<class T_function>
-double evaluate(T_function f, double x) {
+template<class T_function, typename T>
+T evaluate(T_function f, T x) {
   return f(x);
 }
 
-template<class T_function>
-double derivate(T_function f, double x) {
+template<class T_function, typename T>
+T derivate(T_function f, T x) {
   return f.deriv(x);
 }
 
@@ -0,0 +1,276 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "require.h"
+#include "General.h"
+#include "Options.h"
+#include "BinaryDataSet.h"
+
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+BinaryDataSetWriter::BinaryDataSetWriter(const char* fname, uint64_t ninstances, bool supervised):
+  _os(fname, ios::binary) {
+  assure(_os, fname);
+
+  memcpy(_header.magic, "RNNB", 4);
+  _header.version = BinaryDataSetHeader::VERSION;
+  _header.byte_order = 0x01020304;
+  _header.domain = Options::instance()->domain();
+  _header.transduction = Options::instance()->transduction();
+  _header.supervised = supervised;
+  _header.input_dim = Options::instance()->input_dim();
+  _header.output_dim = Options::instance()->output_dim();
+  _header.norient = num_orientations((Domain)_header.domain);
+  _header.reserved = 0;
+  _header.ninstances = ninstances;
+
+  // the offsets are known as the instances are written
+  _os.write((const char*)&_header, sizeof(_header));
+  _offsets.reserve(ninstances);
+  vector<uint64_t> offsets(ninstances, 0);
+  _os.write((const char*)offsets.data(), ninstances*sizeof(uint64_t));
+}
+
+void BinaryDataSetWriter::pad(int alignment) {
+  static const char zeros[8] = { 0 };
+  _os.write(zeros, (alignment - _os.tellp()%alignment)%alignment);
+}
+
+void BinaryDataSetWriter::write_ints(const vector<int>& v) {
+  _os.write((const char*)v.data(), v.size()*sizeof(int32_t));
+}
+
+void BinaryDataSetWriter::write(Instance* instance) {
+  require(_offsets.size() < _header.ninstances, "Writing more instances than declared");
+  require(instance->domain() == _header.domain, "Instance domain differs from the data set one");
+
+  pad(8);
+  _offsets.push_back(_os.tellp());
+
+  const int nn = instance->num_nodes();
+  const string id = instance->id();
+  int32_t record[4] = { nn, 0, 0, (int32_t)id.size() };
+  if(_header.domain == GRID2D) {
+    record[1] = instance->grid_rows();
+    record[2] = instance->grid_cols();
+  }
+  _os.write((const char*)record, sizeof(record));
+  _os.write(id.data(), id.size());
+  pad(4);
+
+  if(_header.transduction == SUPER_SOURCE && _header.supervised) {
+    vector<float> target = instance->target();
+    require((int)target.size() == _header.output_dim, "Instance target dimension differs from the data set one");
+    _os.write((const char*)target.data(), target.size()*sizeof(float));
+  }
+
+  for(int t=0; t<nn; ++t) {
+    Node* node = instance->node(t);
+    require(node->input_dim() == _header.input_dim, "Node input dimension differs from the data set one");
+    _os.write((const char*)node->input_data(), node->input_dim()*sizeof(float));
+  }
+  if(_header.transduction == IO_ISOMORPH && _header.supervised)
+    for(int t=0; t<nn; ++t) {
+      Node* node = instance->node(t);
+      require(node->output_dim() == _header.output_dim, "Node target dimension differs from the data set one");
+      _os.write((const char*)node->target_data(), node->output_dim()*sizeof(float));
+    }
+
+  if(instance->implicit())
+    return;
+
+  // the orientations in compact form, with both children and parents
+  for(int o=0; o<_header.norient; ++o) {
+    Instance::OrientationRef orientation = instance->oriented(o);
+    const CSRGraph& graph = orientation->graph;
+    assert(graph.has_reverse());
+
+    const int32_t ne = graph.num_edges();
+    _os.write((const char*)&ne, sizeof(ne));
+
+    vector<int> out_offsets(1, 0), targets, positions, in_offsets(1, 0), sources;
+    for(int t=0; t<nn; ++t) {
+      for(int c=graph.out_begin(t); c<graph.out_end(t); ++c) {
+	targets.push_back(graph.target(c));
+	positions.push_back(graph.position(c));
+      }
+      out_offsets.push_back(targets.size());
+
+      for(int c=graph.in_begin(t); c<graph.in_end(t); ++c)
+	sources.push_back(graph.source(c));
+      in_offsets.push_back(sources.size());
+    }
+    write_ints(out_offsets);
+    write_ints(targets);
+    write_ints(positions);
+    write_ints(in_offsets);
+    write_ints(sources);
+    write_ints(orientation->order);
+  }
+}
+
+void BinaryDataSetWriter::close() {
+  if(!_os.is_open())
+    return;
+
+  require(_offsets.size() == _header.ninstances, "Writing fewer instances than declared");
+  _os.seekp(sizeof(_header));
+  _os.write((const char*)_offsets.data(), _offsets.size()*sizeof(uint64_t));
+  _os.close();
+}
+
+BinaryDataSetReader::BinaryDataSetReader(const char* fname) {
+  int fd = open(fname, O_RDONLY);
+  require(fd >= 0, string("Could not open file ") + fname);
+  struct stat st;
+  require(fstat(fd, &st) == 0, string("Could not stat file ") + fname);
+  _size = st.st_size;
+  require(_size >= sizeof(BinaryDataSetHeader), string("Not a binary data set: ") + fname);
+
+  void* data = mmap(0, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  require(data != MAP_FAILED, string("Could not map file ") + fname);
+  const size_t size = _size;
+  _file = shared_ptr<const void>(data, [size](const void* p) { munmap(const_cast<void*>(p), size); });
+
+  _header = (const BinaryDataSetHeader*)data;
+  require(!memcmp(_header->magic, "RNNB", 4), string("Not a binary data set: ") + fname);
+  require(_header->version == BinaryDataSetHeader::VERSION, "Unsupported binary data set version");
+  require(_header->byte_order == 0x01020304, "Binary data set written with a different byte order");
+  require(_header->ninstances <= (_size - sizeof(BinaryDataSetHeader))/sizeof(uint64_t),
+	  "Truncated binary data set");
+  _offsets = (const uint64_t*)(_header + 1);
+
+  // the instances are processed according to the options
+  require(_header->domain == Options::instance()->domain(), "Data set domain differs from the configured one");
+  require(_header->transduction == Options::instance()->transduction(),
+	  "Data set transduction differs from the configured one");
+  require(_header->input_dim == Options::instance()->input_dim(),
+	  "Data set input dimension differs from the configured one");
+  require(!_header->supervised || _header->output_dim == Options::instance()->output_dim(),
+	  "Data set output dimension differs from the configured one");
+  require(_header->norient == num_orientations((Domain)_header->domain),
+	  "Bad number of orientations in binary data set");
+}
+
+bool BinaryDataSetReader::is_binary(const char* fname) {
+  ifstream is(fname, ios::binary);
+  char magic[4];
+  return is.read(magic, 4) && !memcmp(magic, "RNNB", 4);
+}
+
+const void* BinaryDataSetReader::section(uint64_t& at, uint64_t count, uint64_t size) const {
+  // at <= _size always holds, check the end without overflowing
+  require(count <= (_size - at)/size, "Truncated binary data set");
+  const void* p = (const char*)_file.get() + at;
+  at += count*size;
+  return p;
+}
+
+// whether the n values are in [0, bound)
+static bool in_range(const int32_t* v, int n, int bound) {
+  for(int k=0; k<n; ++k)
+    if(v[k] < 0 || v[k] >= bound)
+      return false;
+  return true;
+}
+
+// whether the offsets of the n nodes go from 0 to ne, not decreasing
+static bool csr_offsets(const int32_t* offsets, int n, int ne) {
+  if(offsets[0] != 0 || offsets[n] != ne)
+    return false;
+  for(int t=0; t<n; ++t)
+    if(offsets[t] > offsets[t+1])
+      return false;
+  return true;
+}
+
+Instance* BinaryDataSetReader::read(uint64_t i) const {
+  assert(i < size());
+  const Domain domain = (Domain)_header->domain;
+  const Transduction transduction = (Transduction)_header->transduction;
+  const int ni = _header->input_dim, no = _header->output_dim;
+
+  // each section is checked to be in the file before it is read
+  uint64_t at = _offsets[i];
+  require(at <= _size && at%8 == 0, "Bad instance offset in binary data set");
+  const int32_t* record = (const int32_t*)section(at, 4, sizeof(int32_t));
+  const int nn = record[0], rows = record[1], cols = record[2], idlen = record[3];
+  require(nn > 0, "Instance with no nodes in binary data set");
+  require(idlen >= 0, "Bad instance id length in binary data set");
+  const char* id = (const char*)section(at, ((uint64_t)idlen + 3)/4*4, 1);
+
+  const float* target = 0;
+  if(transduction == SUPER_SOURCE && _header->supervised)
+    target = (const float*)section(at, no, sizeof(float));
+  const float* inputs = (const float*)section(at, (uint64_t)nn*ni, sizeof(float));
+  const float* targets = 0;
+  if(transduction == IO_ISOMORPH && _header->supervised)
+    targets = (const float*)section(at, (uint64_t)nn*no, sizeof(float));
+  if(domain == GRID2D)
+    require(rows > 0 && cols > 0 && (int64_t)rows*cols == nn, "Bad grid shape in binary data set");
+
+  // the orientations of the domains which are not implicit
+  Instance* instance = new Instance(domain, transduction, _header->supervised);
+  Instance::Skeleton* skel = new Instance::Skeleton(domain, nn);
+  if(!instance->implicit())
+    for(int o=0; o<_header->norient; ++o) {
+      const int ne = *(const int32_t*)section(at, 1, sizeof(int32_t));
+      require(ne >= 0, "Bad number of edges in binary data set");
+      const int32_t* out = (const int32_t*)section(at, (uint64_t)nn+1, sizeof(int32_t));
+      const int32_t* tg = (const int32_t*)section(at, ne, sizeof(int32_t));
+      const int32_t* pos = (const int32_t*)section(at, ne, sizeof(int32_t));
+      const int32_t* in = (const int32_t*)section(at, (uint64_t)nn+1, sizeof(int32_t));
+      const int32_t* src = (const int32_t*)section(at, ne, sizeof(int32_t));
+      const int32_t* order = (const int32_t*)section(at, nn, sizeof(int32_t));
+      require(csr_offsets(out, nn, ne) && csr_offsets(in, nn, ne) &&
+	      in_range(tg, ne, nn) && in_range(src, ne, nn) && in_range(pos, ne, ne) &&
+	      in_range(order, nn, nn), "Bad orientation in binary data set");
+      skel->stored(CSRGraph(nn, ne, out, tg, pos, in, src), order);
+    }
+
+  instance->id(string(id, idlen));
+  if(target)
+    instance->load_target(vector<float>(target, target + no));
+
+  // the nodes are views of their labels
+  instance->_nodes.reserve(nn);
+  for(int t=0; t<nn; ++t) {
+    Node* n = new Node;
+    n->view(inputs + (uint64_t)t*ni, ni, targets?targets + (uint64_t)t*no:0, targets?no:0);
+    instance->_nodes.push_back(n);
+  }
+
+  if(domain == GRID2D)
+    skel->grid(rows, cols);
+  instance->skeleton(skel);
+  instance->_storage = _file;
+
+  return instance;
+}
@@ -0,0 +1,126 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _BINARY_DATA_SET_H_
+#define _BINARY_DATA_SET_H_
+
+#include "Instance.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+/*
+
+  Binary data set format, to load data sets without parsing them: the
+  file is memory-mapped and the instances read are views of it, which
+  keep it mapped as long as any of them is alive.
+
+  Native (little-endian) 32 bit integers and floats, the instances at
+  offsets multiple of 8:
+
+  header    see BinaryDataSetHeader, then the offset (64 bit) of
+            each instance in the file
+  instance  number of nodes, rows and columns (GRID2D, 0 otherwise),
+            length of the id, then the id, padded to a multiple of 4
+            bytes, the target of the instance (SUPER_SOURCE), the input
+            labels of the nodes and then their targets (IO_ISOMORPH);
+            DOAG and UG only, for each orientation: number of edges,
+            out offsets, targets, positions, in offsets, sources (see
+            CSRGraph) and a topological order
+
+  Sequences and grids need no topology (see Instance::implicit). The
+  data sets are written by gph2bin from the text format, read by the
+  DataSet constructor whichever the format.
+
+ */
+struct BinaryDataSetHeader {
+  char magic[4];         // "RNNB"
+  uint32_t version;      // BinaryDataSetHeader::VERSION
+  uint32_t byte_order;   // 0x01020304, as written
+  int32_t domain, transduction, supervised;
+  int32_t input_dim, output_dim;
+  int32_t norient;
+  uint32_t reserved;     // 0
+  uint64_t ninstances;
+
+  static const uint32_t VERSION = 1;
+};
+
+/*
+  Write the instances of a data set, one at a time, in the format
+  above: the domain, the transduction and the dimensions are those
+  of the current options.
+*/
+class BinaryDataSetWriter {
+  std::ofstream _os;
+  BinaryDataSetHeader _header;
+  std::vector<uint64_t> _offsets;
+
+  void pad(int);
+  void write_ints(const std::vector<int>&);
+
+  // prevent assignment and copy construction
+  BinaryDataSetWriter(const BinaryDataSetWriter&);
+  BinaryDataSetWriter& operator=(const BinaryDataSetWriter&);
+
+ public:
+  BinaryDataSetWriter(const char*, uint64_t ninstances, bool supervised = true);
+  ~BinaryDataSetWriter() { close(); }
+
+  void write(Instance*);
+  // write the offsets of the instances, all of them must be written
+  void close();
+};
+
+/*
+  Read the instances of a memory-mapped data set in the format above.
+*/
+class BinaryDataSetReader {
+  std::shared_ptr<const void> _file; // unmapped when the last view goes
+  size_t _size;
+  const BinaryDataSetHeader* _header;
+  const uint64_t* _offsets;
+
+  // count values of the given size at offset at, which is moved past
+  // them, after checking that they are in the file
+  const void* section(uint64_t& at, uint64_t count, uint64_t size) const;
+
+  // prevent assignment and copy construction
+  BinaryDataSetReader(const BinaryDataSetReader&);
+  BinaryDataSetReader& operator=(const BinaryDataSetReader&);
+
+ public:
+  BinaryDataSetReader(const char*);
+
+  // whether the file is in the binary format
+  static bool is_binary(const char*);
+
+  uint64_t size() const { return _header->ninstances; }
+  // the i-th instance, whoever calls gets responsibility of it
+  Instance* read(uint64_t i) const;
+};
+
+#endif // _BINARY_DATA_SET_H_
@@ -122,6 +122,191 @@ std::vector<int> topological_sort(const DPAG& dpag) {
   return linear_ordering;
 }
 
+std::vector<std::vector<int> > topological_levels(const DPAG& dpag, const std::vector<int>& top_order) {
+  VertexId vertex_id = boost::get(boost::vertex_index, dpag);
+  outIter out_i, out_end;
+
+  // visit nodes in reverse topological order, so that the
+  // height of the children of a node is known before the node
+  vector<int> height(boost::num_vertices(dpag), 0);
+  vector<vector<int> > levels;
+  for(vector<int>::const_reverse_iterator r_it=top_order.rbegin(); r_it!=top_order.rend(); ++r_it) {
+    int h = 0;
+    for(boost::tie(out_i, out_end)=boost::out_edges(boost::vertex(*r_it, dpag), dpag); out_i!=out_end; ++out_i) {
+      int hc = height[vertex_id[boost::target(*out_i, dpag)]] + 1;
+      if(h < hc) h = hc;
+    }
+    height[*r_it] = h;
+
+    if((uint)h >= levels.size())
+      levels.resize(h+1);
+    levels[h].push_back(*r_it);
+  }
+
+  return levels;
+}
+
+std::vector<std::vector<int> > topological_levels(const CSRGraph& graph, const std::vector<int>& top_order) {
+  // as for DPAGs: the children of a node are visited in
+  // the same order, so are the nodes in each level
+  vector<int> height(graph.num_vertices(), 0);
+  vector<vector<int> > levels;
+  for(vector<int>::const_reverse_iterator r_it=top_order.rbegin(); r_it!=top_order.rend(); ++r_it) {
+    int h = 0;
+    for(int c=graph.out_begin(*r_it); c<graph.out_end(*r_it); ++c) {
+      int hc = height[graph.target(c)] + 1;
+      if(h < hc) h = hc;
+    }
+    height[*r_it] = h;
+
+    if((uint)h >= levels.size())
+      levels.resize(h+1);
+    levels[h].push_back(*r_it);
+  }
+
+  return levels;
+}
+
+CSRGraph::CSRGraph(): _out_offsets(1, 0), _view(false) {
+  bind();
+}
+
+CSRGraph::CSRGraph(int nv, int ne, const int* out_offsets, const int* targets, const int* positions,
+		   const int* in_offsets, const int* sources):
+  _view(true), _nv(nv), _ne(ne), _out(out_offsets), _tg(targets), _pos(positions),
+  _in(in_offsets), _src(sources) {
+  assert((in_offsets == 0) == (sources == 0));
+}
+
+CSRGraph::CSRGraph(const CSRGraph& graph) {
+  *this = graph;
+}
+
+CSRGraph& CSRGraph::operator=(const CSRGraph& graph) {
+  if(this == &graph)
+    return *this;
+
+  _out_offsets = graph._out_offsets;
+  _targets = graph._targets;
+  _positions = graph._positions;
+  _in_offsets = graph._in_offsets;
+  _sources = graph._sources;
+
+  _view = graph._view;
+  _nv = graph._nv; _ne = graph._ne;
+  _out = graph._out; _tg = graph._tg; _pos = graph._pos;
+  _in = graph._in; _src = graph._src;
+  if(!_view)
+    bind();
+
+  return *this;
+}
+
+void CSRGraph::bind() {
+  _nv = _out_offsets.size()-1;
+  _ne = _targets.size();
+  _out = _out_offsets.data();
+  _tg = _targets.data();
+  _pos = _positions.data();
+  _in = _in_offsets.empty()?0:_in_offsets.data();
+  _src = _in_offsets.empty()?0:_sources.data();
+}
+
+CSRGraph::CSRGraph(const DPAG& dpag, bool reverse): _view(false) {
+  VertexId vertex_id = boost::get(boost::vertex_index, dpag);
+  cEdgeId edge_id = boost::get(boost::edge_index, dpag);
+  outIter out_i, out_end;
+  ieIter in_i, in_end;
+
+  const int nn = boost::num_vertices(dpag), ne = boost::num_edges(dpag);
+  _out_offsets.reserve(nn+1);
+  _targets.reserve(ne);
+  _positions.reserve(ne);
+
+  _out_offsets.push_back(0);
+  for(int t=0; t<nn; ++t) {
+    for(boost::tie(out_i, out_end)=boost::out_edges(boost::vertex(t, dpag), dpag); out_i!=out_end; ++out_i) {
+      _targets.push_back(vertex_id[boost::target(*out_i, dpag)]);
+      _positions.push_back(edge_id[*out_i]);
+    }
+    _out_offsets.push_back(_targets.size());
+  }
+  bind();
+
+  if(!reverse)
+    return;
+
+  _in_offsets.reserve(nn+1);
+  _sources.reserve(ne);
+  _in_offsets.push_back(0);
+  for(int t=0; t<nn; ++t) {
+    for(boost::tie(in_i, in_end)=boost::in_edges(boost::vertex(t, dpag), dpag); in_i!=in_end; ++in_i)
+      _sources.push_back(vertex_id[boost::source(*in_i, dpag)]);
+    _in_offsets.push_back(_sources.size());
+  }
+  bind();
+}
+
+size_t CSRGraph::bytes() const {
+  return (_out_offsets.capacity() + _targets.capacity() + _positions.capacity() +
+	  _in_offsets.capacity() + _sources.capacity()) * sizeof(int);
+}
+
+void CSRGraph::to_dpag(DPAG* dpag) const {
+  assert(boost::num_vertices(*dpag) == 0);
+
+  const int nn = num_vertices();
+  for(int t=0; t<nn; ++t)
+    boost::add_vertex(*dpag);
+
+  if(!has_reverse()) {
+    for(int t=0; t<nn; ++t)
+      for(int c=out_begin(t); c<out_end(t); ++c)
+	boost::add_edge(t, target(c), EdgeProperty(position(c)), *dpag);
+    return;
+  }
+
+  /*
+   * The in edges of a vertex are in the order the edges are added:
+   * add them so that both the children and the parents of each vertex
+   * come in the same order as in the DPAG the graph was built from.
+   * First match each edge with its slot among the parents of its target.
+   */
+  vector<int> slot(num_edges(), -1);
+  vector<bool> taken(num_edges(), false);
+  for(int s=0; s<nn; ++s)
+    for(int c=out_begin(s); c<out_end(s); ++c)
+      for(int k=in_begin(target(c)); k<in_end(target(c)); ++k)
+	if(!taken[k] && source(k) == s) {
+	  slot[c] = k;
+	  taken[k] = true;
+	  break;
+	}
+
+  // then add the next edge of a vertex when it is also
+  // the next parent of its target, until none is left
+  vector<int> next_child(_out, _out + nn);
+  vector<int> next_parent(_in, _in + nn);
+  vector<int> pending;
+  for(int s=nn-1; s>=0; --s)
+    pending.push_back(s);
+
+  while(!pending.empty()) {
+    int s = pending.back();
+    pending.pop_back();
+
+    int c;
+    while((c = next_child[s]) < out_end(s) && slot[c] == next_parent[target(c)]) {
+      const int t = target(c);
+      boost::add_edge(s, t, EdgeProperty(position(c)), *dpag);
+      ++next_child[s];
+      if(++next_parent[t] < in_end(t))
+	pending.push_back(source(next_parent[t]));
+    }
+  }
+  assert(boost::num_edges(*dpag) == (uint)num_edges());
+}
+
 void build_grid(const std::string& direction, int rows, int cols, DPAG *dpag) {
   int num_nodes = rows * cols;
   assert(boost::num_vertices(*dpag) == (uint)num_nodes &&  
@@ -133,16 +318,16 @@ void build_grid(const std::string& direction, int rows, int cols, DPAG *dpag) {
       for(int j=0; j<cols; ++j) {
 	int edge_index = 0;
 	if(j<cols-1)
-	  boost::add_edge(i*rows+j, i*rows+j+1, EdgeProperty(edge_index++), *dpag);
+	  boost::add_edge(i*cols+j, i*cols+j+1, EdgeProperty(edge_index++), *dpag);
 	if(i<rows-1)
-	  boost::add_edge(i*rows+j, (i+1)*rows+j, EdgeProperty(edge_index++), *dpag);
+	  boost::add_edge(i*cols+j, (i+1)*cols+j, EdgeProperty(edge_index++), *dpag);
       }
     }
     
     // int index = 0;
     // for(int j=0; j<cols; ++j) {
     //   for(int i=0; i<rows; ++i) {
-    // 	top_ord[index++] = i*rows+j;
+    // 	top_ord[index++] = i*cols+j;
     //   }
     // }
   } else if(direction == "senw") {
@@ -150,16 +335,16 @@ void build_grid(const std::string& direction, int rows, int cols, DPAG *dpag) {
       for(int j=cols-1; j>=0; --j) {
 	int edge_index = 0;
 	if(j>0)
-	  boost::add_edge(i*rows+j, i*rows+j-1, EdgeProperty(edge_index++), *dpag);
+	  boost::add_edge(i*cols+j, i*cols+j-1, EdgeProperty(edge_index++), *dpag);
 	if(i>0)
-	  boost::add_edge(i*rows+j, (i-1)*rows+j, EdgeProperty(edge_index++), *dpag);
+	  boost::add_edge(i*cols+j, (i-1)*cols+j, EdgeProperty(edge_index++), *dpag);
       }
     }
     
     // int index = 0;
     // for(int i=rows-1; i>=0; --i) {
     //   for(int j=cols-1; j>=0; --j) {
-    // 	top_ord[index++] = i*rows+j;
+    // 	top_ord[index++] = i*cols+j;
     //   }
     // }
   } else if(direction == "nesw") {
@@ -167,16 +352,16 @@ void build_grid(const std::string& direction, int rows, int cols, DPAG *dpag) {
       for(int j=cols-1; j>=0; --j) {
 	int edge_index = 0;
 	if(j>0)
-	  boost::add_edge(i*rows+j, i*rows+j-1, EdgeProperty(edge_index++), *dpag);
+	  boost::add_edge(i*cols+j, i*cols+j-1, EdgeProperty(edge_index++), *dpag);
 	if(i<rows-1)
-	  boost::add_edge(i*rows+j, (i+1)*rows+j, EdgeProperty(edge_index++), *dpag);
+	  boost::add_edge(i*cols+j, (i+1)*cols+j, EdgeProperty(edge_index++), *dpag);
       }
     }
     
     // int index = 0;
     // for(int j=cols-1; j>=0; --j) {
     //   for(int i=0; i<rows; ++i) {
-    // 	top_ord[index++] = i*rows+j;
+    // 	top_ord[index++] = i*cols+j;
     //   }
     // }
   } else if(direction == "swne") {
@@ -184,16 +369,16 @@ void build_grid(const std::string& direction, int rows, int cols, DPAG *dpag) {
       for(int j=0; j<cols; ++j) {
 	int edge_index = 0;
 	if(j<cols-1)
-	  boost::add_edge(i*rows+j, i*rows+j+1, EdgeProperty(edge_index++), *dpag);
+	  boost::add_edge(i*cols+j, i*cols+j+1, EdgeProperty(edge_index++), *dpag);
 	if(i>0)
-	  boost::add_edge(i*rows+j, (i-1)*rows+j, EdgeProperty(edge_index++), *dpag);
+	  boost::add_edge(i*cols+j, (i-1)*cols+j, EdgeProperty(edge_index++), *dpag);
       }
     }
     
     // int index = 0;
     // for(int i=rows-1; i>=0; --i) {
     //   for(int j=0; j<cols; ++j) {
-    // 	top_ord[index++] = i*rows+j;
+    // 	top_ord[index++] = i*cols+j;
     //   }
     // }
 
@@ -72,11 +72,73 @@ unsigned int max_outdegree(const DPAG&);
 // Function to produce a topological ordering of the nodes of a DPAG
 std::vector<int> topological_sort(const DPAG&);
 
+// Function to group the nodes of a DPAG by height (longest path to a leaf),
+// given one of its topological orderings: nodes in the same group do not
+// depend on each other and groups are returned leaves first.
+std::vector<std::vector<int> > topological_levels(const DPAG&, const std::vector<int>&);
+
+/*
+
+  Compact, immutable representation of a DPAG in compressed sparse row
+  form, to keep the topology of parsed instances: the children of node t
+  are target(c), at position (edge index) position(c), for c in
+  [out_begin(t), out_end(t)), in the order of the out edges of t in the
+  DPAG it is built from. The parents can be kept too (reverse CSR):
+  source(c) for c in [in_begin(t), in_end(t)).
+
+  Convert it back (to_dpag) to use the functions above.
+
+  The arrays are either held by the graph or, for views, kept
+  elsewhere in the same layout, e.g. in a memory-mapped data set.
+
+ */
+class CSRGraph {
+  std::vector<int> _out_offsets, _targets, _positions;
+  std::vector<int> _in_offsets, _sources;
+
+  // the arrays in use, those above unless the graph is a view
+  bool _view;
+  int _nv, _ne;
+  const int *_out, *_tg, *_pos, *_in, *_src;
+  void bind();
+
+ public:
+  CSRGraph();
+  CSRGraph(const DPAG&, bool reverse = false);
+  // view of arrays which must outlive it, in_offsets and sources may be 0
+  CSRGraph(int nv, int ne, const int* out_offsets, const int* targets, const int* positions,
+	   const int* in_offsets = 0, const int* sources = 0);
+  CSRGraph(const CSRGraph&);
+  CSRGraph& operator=(const CSRGraph&);
+
+  int num_vertices() const { return _nv; }
+  int num_edges() const { return _ne; }
+
+  int out_begin(int t) const { return _out[t]; }
+  int out_end(int t) const { return _out[t+1]; }
+  int target(int c) const { return _tg[c]; }
+  int position(int c) const { return _pos[c]; }
+
+  bool has_reverse() const { return _in != 0; }
+  int in_begin(int t) const { return _in[t]; }
+  int in_end(int t) const { return _in[t+1]; }
+  int source(int c) const { return _src[c]; }
+
+  // memory held by the arrays, in bytes (none for views)
+  size_t bytes() const;
+  
+  // the equivalent DPAG, dpag must have no vertices
+  void to_dpag(DPAG* dpag) const;
+};
+
 // Function to construct the grids corresponding
 // to the four processing direction of a Recursive Neural Network
 // applid to bidimensional grid domains
 void build_grid(const std::string&, int, int, DPAG*);
 
+// Same as above, for a graph in compact form
+std::vector<std::vector<int> > topological_levels(const CSRGraph&, const std::vector<int>&);
+
 // print DPAG to output stream
 void printDPAG(const DPAG& dpag, std::ostream&);
 
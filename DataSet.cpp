@@ -25,11 +25,26 @@
 #include "require.h"
 #include "General.h"
 #include "InstanceParser.h"
+#include "BinaryDataSet.h"
 #include "DataSet.h"
 #include <iostream>
+#include <algorithm>
 using namespace std;
 
 DataSet::DataSet(const char* fname, bool own): _own(own), _nnodes(0) {
+  // binary data sets are mapped, their instances are views
+  if(BinaryDataSetReader::is_binary(fname)) {
+    BinaryDataSetReader reader(fname);
+    require(reader.size(), "Dataset size == 0");
+    reserve(reader.size());
+    for(uint64_t i=0; i<reader.size(); ++i) {
+      Instance* instance = reader.read(i);
+      push_back(instance);
+      _nnodes += instance->num_nodes();
+    }
+    return;
+  }
+
   ifstream is(fname);
   assure(is, fname);
 
@@ -78,3 +93,17 @@ void DataSet::shuffle() {
     (*this)[p2] = tmp;
   }
 }
+
+void DataSet::shuffle(mt19937& rng) {
+  std::shuffle(begin(), end(), rng);
+}
+
+DataSet::const_iterator DataSet::batch_end(const_iterator first, int ninstances, int nnodes) const {
+  const_iterator last = first;
+  int nodes = 0;
+  while(last != end() &&
+	(!ninstances || last - first < ninstances) &&
+	(!nnodes || nodes < nnodes))
+    nodes += (*last++)->num_nodes();
+  return last;
+}
@@ -27,6 +27,7 @@
 
 #include "Instance.h"
 #include <vector>
+#include <random>
 
 class DataSet: public std::vector<Instance*> {
   // would include a map from instance names to positions
@@ -40,11 +41,17 @@ class DataSet: public std::vector<Instance*> {
  public:
   // flag signal pointer ownership
  DataSet(bool own = true): _own(own), _nnodes(0) {}
+  // read a data set, in text or binary format (see BinaryDataSet.h)
   DataSet(const char*, bool = true);
   ~DataSet();
 
   void add(Instance*);
   void shuffle();
+  // same, drawing from the given generator so that the order can be reproduced
+  void shuffle(std::mt19937&);
+  // the end of the batch of instances beginning at the given one: at most
+  // ninstances instances, fewer as soon as they hold nnodes nodes (0: no limit)
+  const_iterator batch_end(const_iterator, int ninstances, int nnodes = 0) const;
   int num_nodes() const { return _nnodes; }
 };
 
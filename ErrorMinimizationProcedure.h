@@ -26,439 +26,414 @@
 /*
   Templatized Strategy Pattern implementation
   of different Error Minimization Procedures.
+
+  Procedures are parameterised on the type of the network
+  weights (T) and of the gradient components (G).
 */
 
 #ifndef _ERROR_MINIMIZATION_PROCEDURE_H
 #define _ERROR_MINIMIZATION_PROCEDURE_H
 
+#include "require.h"
+#include "ParameterArena.h"
+#include "Kernels.h"
+#include "Options.h"
+
+#include <cmath>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 using std::cout;
 using std::endl;
 
 /* Simple Gradient Descent */
+template<typename T, typename G = T>
 class GradientDescent {
   // Simply update networks weights in the opposite direction 
   // of the current gradient stored in the net and with a 
   // distance defined by learning rate.
-  bool _ss_tr, _ios_tr;
-  int _norient, _n, _v, _m, _r, _s;
-  std::vector<int> _lnunits;
 
   public:
-  template<typename T1, typename T2, typename T3, template<typename, typename, typename> class RNN>
-    void setInternals(RNN<T1, T2, T3>* const rnn);
+  template<class RNN>
+    void setInternals(RNN* const) {}
 
-  template<typename T1, typename T2, typename T3, template<typename, typename, typename> class RNN>
-    void updateWeights(RNN<T1, T2, T3>* const rnn, double, double = 0.0);
+  template<class RNN>
+    void updateWeights(RNN* const rnn, float, float = .0, float = .0);
 };
 
-template<typename T1, typename T2, typename T3, template<typename, typename, typename> class RNN>
-  void GradientDescent::setInternals(RNN<T1, T2, T3>* const rnn) {
-    // Simply synchronize private member with those of recursive network
-    _norient = rnn->_norient;
-    _ss_tr = rnn->_ss_tr;
-    _ios_tr = rnn->_ios_tr;
-    _n = rnn->_n, _v = rnn->_v, _m = rnn->_m, _r = rnn->_r, _s = rnn->_s;
-    _lnunits = rnn->_lnunits;
-}
-
-template<typename T1, typename T2, typename T3, template<typename, typename, typename> class RNN> 
-void GradientDescent::updateWeights(RNN<T1, T2, T3>* const rnn, double _learning_rate, double) {
+template<typename T, typename G>
+template<class RNN>
+void GradientDescent<T, G>::updateWeights(RNN* const rnn, float _learning_rate, float, float) {
   // rnn (the recursive network) store gradient components, so to obtain
   // weight update rule change the sign of these components and multiply
-  // by the learning rate
-  
-  if(_ss_tr) {
-    // begin with layers of the MLP output function
-    for(int i=0; i<_norient*_m; i++) {
-      for(int j=0; j<_lnunits[_r]; j++) {
-	// Save parameters in case we make a bad move.
-	rnn->_prev_g_layers_w[0][i][j] = rnn->_g_layers_w[0][i][j];
-	rnn->_g_layers_w[0][i][j] += -_learning_rate * rnn->_g_layers_gradient_w[0][i][j];
-      }
-    }
-    // this could go inside the previous loop
-    for(int j=0; j<_lnunits[_r]; j++) {
-      rnn->_prev_g_layers_w[0][_norient*_m][j] = rnn->_g_layers_w[0][_norient*_m][j];
-      rnn->_g_layers_w[0][_norient*_m][j] += -_learning_rate * rnn->_g_layers_gradient_w[0][_norient*_m][j];
-    }
-    for(int k=1; k<_s; k++) {
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	for(int j=0; j<_lnunits[_r+k]; j++) {
-	  rnn->_prev_g_layers_w[k][i][j] = rnn->_g_layers_w[k][i][j];
-	  rnn->_g_layers_w[k][i][j] += -_learning_rate * rnn->_g_layers_gradient_w[k][i][j];
-	}
-      }
-    }
-  }
-
-  if(_ios_tr) {
-    // proceed with layers of the h map
-    for(int i=0; i<_norient*_m+_n; i++) {
-      for(int j=0; j<_lnunits[_r]; j++) {
-	rnn->_prev_h_layers_w[0][i][j] = rnn->_h_layers_w[0][i][j];
-	rnn->_h_layers_w[0][i][j] += -_learning_rate * rnn->_h_layers_gradient_w[0][i][j];
-      }
-    }
-    // this could inside the previous loop
-    for(int j=0; j<_lnunits[_r]; j++) {
-      rnn->_prev_h_layers_w[0][_norient*_m + _n][j] = rnn->_h_layers_w[0][_norient*_m + _n][j];
-      rnn->_h_layers_w[0][_norient*_m + _n][j] += -_learning_rate * rnn->_h_layers_gradient_w[0][_norient*_m + _n][j];
-    }
-    for(int k=1; k<_s; k++) {
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	for(int j=0; j<_lnunits[_r+k]; j++) {
-	  rnn->_prev_h_layers_w[k][i][j] = rnn->_h_layers_w[k][i][j];
-	  rnn->_h_layers_w[k][i][j] += -_learning_rate * rnn->_h_layers_gradient_w[k][i][j];
-	}
-      }
-    }
-  }
-
-  // proceed with the folding layers
-  for(int o=0; o<_norient; ++o) {
-    for(int i=0; i<(_n+_v*_m) + 1; i++) {
-      for(int j=0; j<_lnunits[0]; j++) {
-	rnn->_prev_layers_w[o][0][i][j] = rnn->_layers_w[o][0][i][j];
-	rnn->_layers_w[o][0][i][j] += -_learning_rate * rnn->_layers_gradient_w[o][0][i][j];
-      }
-    }
-    
-    for(int k=1; k<_r; k++) {
-      for(int i=0; i<_lnunits[k-1]+1; i++) {
-	for(int j=0; j<_lnunits[k]; j++) {
-	  rnn->_prev_layers_w[o][k][i][j] = rnn->_layers_w[o][k][i][j];
-	  rnn->_layers_w[o][k][i][j] += -_learning_rate * rnn->_layers_gradient_w[o][k][i][j];
-	}
-      }
-    }
-  }
+  // by the learning rate.
+  // Weights of the output function and of the folding layers are
+  // stored contiguously and can be updated in a single sweep.
+  // New weights are written where the net asks (in place unless
+  // it keeps the current ones to rollback a bad move).
+  const T* w = rnn->_w.data();
+  T* new_w = rnn->updatedWeights();
+  const G* gradient_w = rnn->_gradient_w.data();
   
+  for(size_t p=0; p<rnn->_w.size(); ++p)
+    new_w[p] = w[p] + -_learning_rate * gradient_w[p];
 }
 
 /* Gradient Descent with momentum */
+template<typename T, typename G = T>
 class MGradientDescent {
   // Store previuos step weights delta values and update
   // weights with net current gradient and these values.
-  double**** _layers_old_deltas_w;
-  double*** _g_layers_old_deltas_w;
-  double*** _h_layers_old_deltas_w;
+  // Deltas share the layout of the network parameters.
+  ParameterArena<G> _old_deltas_w;
 
-  bool _ss_tr, _ios_tr;
-  int _norient, _n, _v, _m, _r, _s;
-  std::vector<int> _lnunits;
+ public:
+  template<class RNN>
+    void setInternals(RNN* const rnn);
 
-  void allocFoldingPart(double**** layers_w) {
-    (*layers_w) = new double**[_r];
-  
-    // Allocate weights and gradient components matrixes
-    // for f folding part. Connections from input layer
-    // have special dimensions.
-    (*layers_w)[0] = new double*[(_n + _v * _m) + 1];
+  template<class RNN>
+    void updateWeights(RNN* const rnn, float = .0, float = .0, float = .0);
+};
 
-    for(int i=0; i<(_n+_v*_m) + 1; i++) {
-      (*layers_w)[0][i] = new double[_lnunits[0]];
+template<typename T, typename G>
+template<class RNN>
+  void MGradientDescent<T, G>::setInternals(RNN* const rnn) {
+  // Assume rnn constructor has allocated its parameters,
+  // old deltas are reset on allocation.
+  _old_deltas_w.allocate(rnn->_w.layout());
+}
 
-      // Reset gradient for corresponding weights
-      memset((*layers_w)[0][i], 0, _lnunits[0] * sizeof(double));
-    }
+template<typename T, typename G>
+template<class RNN>
+  void MGradientDescent<T, G>::updateWeights(RNN* const rnn, float _learning_rate, float momentum_term, float ni) {
+  // rnn (the recursive network) store gradient components, so to obtain
+  // weight update rule change the sign of this components, multiply
+  // by the learning rate and add multiplication of momentum_term
+  // with old weights deltas.
+  // The whole model (output function and folding layers) is walked as one span.
+  // New weights are written where the net asks (see GradientDescent).
+  const T* w = rnn->_w.data();
+  T* new_w = rnn->updatedWeights();
+  const G* gradient_w = rnn->_gradient_w.data();
+  G* old_deltas_w = _old_deltas_w.data();
   
-    // Allocate f weights&gradient matrixes for f folding part.
-    for(int k=1; k<_r; k++) {
-      // Allocate space for weight&delta matrix between layer i-1 and i.
-      // Automatically include space for threshold unit in layer i-1
-      (*layers_w)[k] = new double*[_lnunits[k-1] + 1];
-
-      for(int i=0; i<_lnunits[k-1]+1; i++) {
-	(*layers_w)[k][i] = new double[_lnunits[k]];
-
-	// Reset f gradient components for corresponding weights
-	memset((*layers_w)[k][i], 0, (_lnunits[k])*sizeof(double));
-      } 
-    }
+  for(size_t p=0; p<rnn->_w.size(); ++p) {
+    const G new_delta_w =
+      -_learning_rate * gradient_w[p] +
+      (momentum_term * old_deltas_w[p]) -
+      (ni * w[p]);
+	
+    new_w[p] = w[p] + new_delta_w;
+    old_deltas_w[p] = new_delta_w;
   }
+}
 
-  void allocSSPart() {
-    _g_layers_old_deltas_w = new double**[_s];
+/* RMSprop */
+template<typename T, typename G = T>
+class RMSprop {
+  // Scale the step of each weight by the root of an exponentially
+  // weighted average of its squared gradient components.
+  // Averages share the layout of the network parameters.
+  ParameterArena<G> _squared_w;
+  double _beta, _epsilon;
 
-    // Allocate weights and gradient components matrixes
-    // for g transforming part. Connections from input layers
-    // have special dimensions.
-    _g_layers_old_deltas_w[0] = new double*[_norient*_m + 1];
+ public:
+  template<class RNN>
+    void setInternals(RNN* const rnn);
 
-    for(int i=0; i<_norient*_m + 1; i++) {
-      _g_layers_old_deltas_w[0][i] = new double[_lnunits[_r]];
+  template<class RNN>
+    void updateWeights(RNN* const rnn, float = .0, float = .0, float = .0);
+};
 
-      // Reset gradient for corresponding weights
-      memset(_g_layers_old_deltas_w[0][i], 0, _lnunits[_r] * sizeof(double));
-    }
+template<typename T, typename G>
+template<class RNN>
+  void RMSprop<T, G>::setInternals(RNN* const rnn) {
+  _squared_w.allocate(rnn->_w.layout());
+  _beta = Options::instance()->beta2();
+  _epsilon = Options::instance()->epsilon();
+}
+
+template<typename T, typename G>
+template<class RNN>
+  void RMSprop<T, G>::updateWeights(RNN* const rnn, float _learning_rate, float, float ni) {
+  // Averages and weights are updated in the same sweep over
+  // the whole model, the momentum term is not used.
+  // New weights are written where the net asks (see GradientDescent).
+  const T* w = rnn->_w.data();
+  T* new_w = rnn->updatedWeights();
+  const G* gradient_w = rnn->_gradient_w.data();
+  G* squared_w = _squared_w.data();
+  const G beta = _beta, epsilon = _epsilon;
   
-    // Allocate weights&gradient matrixes for g transforming part
-    for(int k=1; k<_s; k++) {
-      // Allocate space for weight&gradient matrixes between layer i-1 and i.
-      // Automatically include space for threshold unit in layer i-1
-      _g_layers_old_deltas_w[k] = new double*[_lnunits[_r+k-1] + 1];
-
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	_g_layers_old_deltas_w[k][i] = new double[_lnunits[_r+k]];
-
-	// Reset g gradient components for corresponding weights
-	memset(_g_layers_old_deltas_w[k][i], 0, (_lnunits[_r+k])*sizeof(double));
-      }
-    }
+  for(size_t p=0; p<rnn->_w.size(); ++p) {
+    squared_w[p] = beta * squared_w[p] + (1 - beta) * gradient_w[p] * gradient_w[p];
+    new_w[p] = w[p] - _learning_rate * gradient_w[p] / (std::sqrt(squared_w[p]) + epsilon) - ni * w[p];
   }
+}
 
-  void allocIOSPart() {
-    _h_layers_old_deltas_w = new double**[_s];
-    
-    // Allocate weights and gradient components matrixes
-    // for h map. Connections from input layers have special dimensions.
-    _h_layers_old_deltas_w[0] = new double*[_norient*_m + _n + 1];
+/* Adam */
+template<typename T, typename G = T>
+class Adam {
+  // The step of each weight is an exponentially weighted average of its
+  // gradient components (first moment) scaled by the root of that of their
+  // squares (second moment), both corrected for their initial bias.
+  // Moments share the layout of the network parameters.
+  ParameterArena<G> _first_w, _second_w;
+  double _beta1, _beta2, _epsilon;
+  int _step; // number of updates so far
 
-    for(int i=0; i<_norient*_m + _n + 1; i++) {
-      _h_layers_old_deltas_w[0][i] = new double[_lnunits[_r]];
+ public:
+  template<class RNN>
+    void setInternals(RNN* const rnn);
 
-      // Reset gradient for corresponding weights
-      memset(_h_layers_old_deltas_w[0][i], 0, _lnunits[_r] * sizeof(double));
-    }
-  
-    // Allocate weights&gradient matrixes for h map
-    for(int k=1; k<_s; k++) {
-      // Allocate space for weight&gradient matrixes between layer i-1 and i.
-      // Automatically include space for threshold unit in layer i-1
-      _h_layers_old_deltas_w[k] = new double*[_lnunits[_r+k-1] + 1];
-
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	_h_layers_old_deltas_w[k][i] = new double[_lnunits[_r+k]];
-
-	// Reset h gradient components for corresponding weights
-	memset(_h_layers_old_deltas_w[k][i], 0, (_lnunits[_r+k])*sizeof(double));
-      }
-    }
-  }
+  template<class RNN>
+    void updateWeights(RNN* const rnn, float = .0, float = .0, float = .0);
+};
 
-  void deallocFoldingPart(double**** layers_w) {
-    if((*layers_w)[0]) {
-      for(int i=0; i<(_n+_v*_m) + 1; i++) {
-	if((*layers_w)[0][i])
-	  delete[] (*layers_w)[0][i];
-	(*layers_w)[0][i] = 0;
-      }
-      delete[] (*layers_w)[0];
-      (*layers_w)[0] = 0;
-    }
+template<typename T, typename G>
+template<class RNN>
+  void Adam<T, G>::setInternals(RNN* const rnn) {
+  _first_w.allocate(rnn->_w.layout());
+  _second_w.allocate(rnn->_w.layout());
+  _beta1 = Options::instance()->beta1();
+  _beta2 = Options::instance()->beta2();
+  _epsilon = Options::instance()->epsilon();
+  _step = 0;
+}
 
-    for(int k=1; k<_r; k++) {
-      if((*layers_w)[k]) {
-	for(int i=0; i<_lnunits[k-1]+1; i++) {
-	  if((*layers_w)[k][i])
-	    delete[] (*layers_w)[k][i];
-	  (*layers_w)[k][i] = 0;
-	}
-	delete[] (*layers_w)[k];
-	(*layers_w)[k] = 0;
-      }
-    
-    }
+template<typename T, typename G>
+template<class RNN>
+  void Adam<T, G>::updateWeights(RNN* const rnn, float _learning_rate, float, float ni) {
+  // Moments and weights are updated in the same sweep over the whole
+  // model, the bias corrections are folded into the step size.
+  // The momentum term is not used, weight decay is decoupled from
+  // the moments. New weights are written where the net asks
+  // (see GradientDescent).
+  ++_step;
+  const G step_size = _learning_rate * std::sqrt(1 - std::pow(_beta2, _step)) / (1 - std::pow(_beta1, _step));
+  const G epsilon = _epsilon * std::sqrt(1 - std::pow(_beta2, _step));
+  const G beta1 = _beta1, beta2 = _beta2;
+
+  const T* w = rnn->_w.data();
+  T* new_w = rnn->updatedWeights();
+  const G* gradient_w = rnn->_gradient_w.data();
+  G* first_w = _first_w.data();
+  G* second_w = _second_w.data();
   
-    delete[] (*layers_w);
-    (*layers_w) = 0;
+  for(size_t p=0; p<rnn->_w.size(); ++p) {
+    first_w[p] = beta1 * first_w[p] + (1 - beta1) * gradient_w[p];
+    second_w[p] = beta2 * second_w[p] + (1 - beta2) * gradient_w[p] * gradient_w[p];
+    new_w[p] = w[p] - step_size * first_w[p] / (std::sqrt(second_w[p]) + epsilon) - ni * w[p];
   }
+}
 
-  void deallocSSPart() {
-    if(_g_layers_old_deltas_w[0]) {
-      for(int i=0; i<_norient*_m + 1; i++) {
-	if(_g_layers_old_deltas_w[0][i])
-	  delete[] _g_layers_old_deltas_w[0][i];
-	_g_layers_old_deltas_w[0][i] = 0;
-      }
-      delete[] _g_layers_old_deltas_w[0];
-      _g_layers_old_deltas_w[0] = 0;
-    }
+/* Rprop */
+template<typename T, typename G = T>
+class Rprop {
+  // Each weight moves by a step of its own against the sign of its
+  // gradient component, regardless of its magnitude. The step grows
+  // while the sign is kept and shrinks when it changes, in which case
+  // the weight is left where it is (iRprop-).
+  // Steps and previous gradient components share the layout of the
+  // network parameters.
+  ParameterArena<G> _steps_w, _old_gradient_w;
 
-    for(int k=1; k<_s; k++) {
-      if(_g_layers_old_deltas_w[k]) {
-	for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	  if(_g_layers_old_deltas_w[k][i])
-	    delete[] _g_layers_old_deltas_w[k][i];
-	  _g_layers_old_deltas_w[k][i] = 0;
-	}
-	delete[] _g_layers_old_deltas_w[k];
-	_g_layers_old_deltas_w[k] = 0;
-      }
-    }
-  
-    delete[] _g_layers_old_deltas_w;
-    _g_layers_old_deltas_w = 0;
-  }
+ public:
+  template<class RNN>
+    void setInternals(RNN* const rnn);
 
-  void deallocIOSPart() {
-    if(_h_layers_old_deltas_w[0]) {
-      for(int i=0; i<_norient*_m + _n + 1; i++) {
-	if(_h_layers_old_deltas_w[0][i])
-	  delete[] _h_layers_old_deltas_w[0][i];
-	_h_layers_old_deltas_w[0][i] = 0;
-      }
-      delete[] _h_layers_old_deltas_w[0];
-      _h_layers_old_deltas_w[0] = 0;
-    }
+  template<class RNN>
+    void updateWeights(RNN* const rnn, float = .0, float = .0, float = .0);
+};
+
+template<typename T, typename G>
+template<class RNN>
+  void Rprop<T, G>::setInternals(RNN* const rnn) {
+  _old_gradient_w.allocate(rnn->_w.layout());
+  _steps_w.allocate(rnn->_w.layout());
+  std::fill(_steps_w.data(), _steps_w.data() + _steps_w.size(), G(.1));
+}
 
-    for(int k=1; k<_s; k++) {
-      if(_h_layers_old_deltas_w[k]) {
-	for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	  if(_h_layers_old_deltas_w[k][i])
-	    delete[] _h_layers_old_deltas_w[k][i];
-	  _h_layers_old_deltas_w[k][i] = 0;
-	}
-	delete[] _h_layers_old_deltas_w[k];
-	_h_layers_old_deltas_w[k] = 0;
-      }
+template<typename T, typename G>
+template<class RNN>
+  void Rprop<T, G>::updateWeights(RNN* const rnn, float, float, float ni) {
+  // Steps and weights are updated in the same sweep over the whole
+  // model, neither the learning rate nor the momentum term are used.
+  // New weights are written where the net asks (see GradientDescent).
+  const G increase = 1.2, decrease = .5, max_step = 50., min_step = 1e-6;
+
+  const T* w = rnn->_w.data();
+  T* new_w = rnn->updatedWeights();
+  const G* gradient_w = rnn->_gradient_w.data();
+  G* steps_w = _steps_w.data();
+  G* old_gradient_w = _old_gradient_w.data();
+
+  for(size_t p=0; p<rnn->_w.size(); ++p) {
+    G gradient = gradient_w[p] + ni * w[p];
+    if(gradient * old_gradient_w[p] > 0)
+      steps_w[p] = std::min(steps_w[p] * increase, max_step);
+    else if(gradient * old_gradient_w[p] < 0) {
+      steps_w[p] = std::max(steps_w[p] * decrease, min_step);
+      gradient = 0;
     }
-  
-    delete[] _h_layers_old_deltas_w;
-    _h_layers_old_deltas_w = 0;
+    new_w[p] = w[p] - ((gradient > 0) - (gradient < 0)) * steps_w[p];
+    old_gradient_w[p] = gradient;
   }
-  
- public:
-  ~MGradientDescent();
+}
 
-  template<typename T1, typename T2, typename T3, template<typename, typename, typename> class RNN>
-    void setInternals(RNN<T1, T2, T3>* const rnn);
+/* Limited memory BFGS */
+template<typename T, typename G = T>
+class LBFGS {
+  // Move the weights along the direction given by an approximation of
+  // the inverse Hessian of the error built from the last m updates, at a
+  // distance found by a backtracking line search on the error of the
+  // training set (see RecursiveNN::lineSearchSet). The search is on the
+  // loss the gradient comes from (see RecursiveNN::computeLoss), with
+  // the weight decay term.
+  // The weight (s) and gradient (y) differences of the updates are the
+  // rows of two contiguous m x size buffers, used as rings.
+  std::vector<G> _s, _y;
+  std::vector<double> _rho, _alpha; // 1/s'y of each update, two-loop coefficients
+  int _m, _size, _first; // capacity, number and row of the oldest update
+  bool _pending; // the last update still waits for its gradient difference
+
+  std::vector<G> _gradient, _direction;
+  // the weights left by the last update, the error there
+  std::vector<T> _w0;
+  double _error;
+
+  G* s(int i) { return &_s[(size_t)((_first + i) % _m) * _gradient.size()]; }
+  G* y(int i) { return &_y[(size_t)((_first + i) % _m) * _gradient.size()]; }
 
-  template<typename T1, typename T2, typename T3, template<typename, typename, typename> class RNN>
-    void updateWeights(RNN<T1, T2, T3>* const rnn, float = .0, float = .0, float = .0);
+ public:
+  template<class RNN>
+    void setInternals(RNN* const rnn);
+
+  template<class RNN>
+    void updateWeights(RNN* const rnn, float = .0, float = .0, float = .0);
 };
 
-MGradientDescent::~MGradientDescent() {
-  for(int i=0; i<_norient; ++i)
-    deallocFoldingPart(&(_layers_old_deltas_w[i]));
-    
-  if(_ss_tr) deallocSSPart();
-  if(_ios_tr) deallocIOSPart();
+template<typename T, typename G>
+template<class RNN>
+  void LBFGS<T, G>::setInternals(RNN* const rnn) {
+  const size_t n = rnn->_w.size();
+  _m = Options::instance()->lbfgs_memory();
+  _s.assign(_m * n, G(0));
+  _y.assign(_m * n, G(0));
+  _rho.assign(_m, .0);
+  _alpha.assign(_m, .0);
+  _size = _first = 0;
+  _pending = false;
+  _gradient.assign(n, G(0));
+  _direction.assign(n, G(0));
+  _w0.clear();
 }
 
-template<typename T1, typename T2, typename T3, template<typename, typename, typename> class RNN>
-  void MGradientDescent::setInternals(RNN<T1, T2, T3>* const rnn) {
-  // Assume rnn constructor has initialized 
-  // required dimension quantities.
-  _norient = rnn->_norient;
-  _ss_tr = rnn->_ss_tr; _ios_tr = rnn->_ios_tr;
-  _n = rnn->_n, _v = rnn->_v, _m = rnn->_m, _r = rnn->_r, _s = rnn->_s;
-  _lnunits = rnn->_lnunits;
-
-  _layers_old_deltas_w = new double***[_norient];
-  for(int i=0; i<_norient; ++i)
-    allocFoldingPart(&(_layers_old_deltas_w[i]));
-  
-  // Finally allocate space for g and or h gradient structures
-  if(_ss_tr) allocSSPart();
-  if(_ios_tr) allocIOSPart();
-}
+template<typename T, typename G>
+template<class RNN>
+  void LBFGS<T, G>::updateWeights(RNN* const rnn, float _learning_rate, float, float ni) {
+  // The learning rate scales the first direction (no history yet),
+  // the momentum term is not used. Trial weights are written in place
+  // to evaluate the error, the accepted ones where the net asks
+  // (see GradientDescent).
+  require(rnn->_line_search_set, "L-BFGS needs a set of instances to search along its directions");
+
+  const int n = _gradient.size();
+  T* w = rnn->_w.data();
+  const G* gradient_w = rnn->_gradient_w.data();
+  G* gradient = &_gradient[0];
+  G* direction = &_direction[0];
+
+  for(int p=0; p<n; ++p)
+    gradient[p] = gradient_w[p] + ni * w[p];
+
+  // the error at the current weights is known unless
+  // they have been changed since the last update
+  if(_w0.empty() || !std::equal(w, w + n, _w0.begin())) {
+    _w0.assign(w, w + n);
+    _error = rnn->computeLoss(rnn->_line_search_set) + ni/2 * rnn->computeWeightsNorm();
+    _pending = false;
+  }
 
-template<typename T1, typename T2, typename T3, template<typename, typename, typename> class RNN>
-  void MGradientDescent::updateWeights(RNN<T1, T2, T3>* const rnn, float _learning_rate, float momentum_term, float ni) {
-  // rnn (the recursive network) store gradient components, so to obtain
-  // weight update rule change the sign of this components, multiply
-  // by the learning rate and add multiplication of momentum_term
-  // with old weights deltas.
-    
-  float new_delta_w = .0;
-  if(_ss_tr) { // begin with layers of the MLP output function
-    for(int i=0; i<_norient*_m + 1; i++) {
-      for(int j=0; j<_lnunits[_r]; j++) {
-	rnn->_prev_g_layers_w[0][i][j] = rnn->_g_layers_w[0][i][j];
-	new_delta_w = 
-	  -_learning_rate * rnn->_g_layers_gradient_w[0][i][j] +
-	  (momentum_term * _g_layers_old_deltas_w[0][i][j]) -
-	  (ni * rnn->_g_layers_w[0][i][j]);
-	
-	rnn->_g_layers_w[0][i][j] += new_delta_w;
-	_g_layers_old_deltas_w[0][i][j] = new_delta_w;
-      }
-    }
-    
-    for(int k=1; k<_s; k++) {
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	for(int j=0; j<_lnunits[_r+k]; j++) {
-	  rnn->_prev_g_layers_w[k][i][j] = rnn->_g_layers_w[k][i][j];
-	  new_delta_w =  
-	    -_learning_rate * rnn->_g_layers_gradient_w[k][i][j] +
-	    (momentum_term * _g_layers_old_deltas_w[k][i][j]) -
-	    (ni * rnn->_g_layers_w[k][i][j]);;
-	  
-	  rnn->_g_layers_w[k][i][j] += new_delta_w;
-	  _g_layers_old_deltas_w[k][i][j] = new_delta_w;
-	}
-      }
+  // complete the last update with its gradient difference,
+  // keep it only if it gives positive curvature
+  if(_pending) {
+    axpy(n, G(1), gradient, y(_size));
+    G sy = dot(n, s(_size), y(_size));
+    if(sy > 1e-10) {
+      _rho[(_first + _size) % _m] = 1. / sy;
+      ++_size;
     }
+    _pending = false;
   }
 
-  if(_ios_tr) { // proceed with layers of the MLP h map
-    new_delta_w = 0.0;
-    
-    for(int i=0; i<_norient*_m + _n + 1; i++) {
-      for(int j=0; j<_lnunits[_r]; j++) {
-	rnn->_prev_h_layers_w[0][i][j] = rnn->_h_layers_w[0][i][j];
-	new_delta_w =  
-	  -_learning_rate * rnn->_h_layers_gradient_w[0][i][j] +
-	  (momentum_term * _h_layers_old_deltas_w[0][i][j]) -
-	  (ni * rnn->_h_layers_w[0][i][j]);
-	
-	rnn->_h_layers_w[0][i][j] += new_delta_w;
-	_h_layers_old_deltas_w[0][i][j] = new_delta_w;
-      }
-    }
+  // two-loop recursion: the direction is minus the approximate
+  // inverse Hessian times the gradient
+  std::copy(gradient, gradient + n, direction);
+  for(int i=_size-1; i>=0; --i) {
+    _alpha[i] = _rho[(_first + i) % _m] * dot(n, s(i), direction);
+    axpy(n, G(-_alpha[i]), y(i), direction);
+  }
+  G gamma = _learning_rate;
+  if(_size)
+    gamma = 1. / (_rho[(_first + _size - 1) % _m] * dot(n, y(_size-1), y(_size-1)));
+  for(int p=0; p<n; ++p)
+    direction[p] *= -gamma;
+  for(int i=0; i<_size; ++i) {
+    double beta = _rho[(_first + i) % _m] * dot(n, y(i), direction);
+    axpy(n, G(-_alpha[i] - beta), s(i), direction);
+  }
 
-    for(int k=1; k<_s; k++) {
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	for(int j=0; j<_lnunits[_r+k]; j++) {
-	  rnn->_prev_h_layers_w[k][i][j] = rnn->_h_layers_w[k][i][j];
-	  new_delta_w =  
-	    -_learning_rate * rnn->_h_layers_gradient_w[k][i][j] +
-	    (momentum_term * _h_layers_old_deltas_w[k][i][j]) -
-	    (ni * rnn->_h_layers_w[k][i][j]);
-	  
-	  rnn->_h_layers_w[k][i][j] += new_delta_w;
-	  _h_layers_old_deltas_w[k][i][j] = new_delta_w;
-	}
-      }
-    }
+  double slope = dot(n, gradient, direction);
+  if(!(slope < 0)) {
+    // not a descent direction, restart from the gradient
+    _size = 0;
+    for(int p=0; p<n; ++p)
+      direction[p] = -_learning_rate * gradient[p];
+    slope = dot(n, gradient, direction);
   }
 
-  // proceed with the folding layers
-  for(int o=0; o<_norient; ++o) {
-    for(int i=0; i<(_n+_v*_m) + 1; i++) {
-      for(int j=0; j<_lnunits[0]; j++) {
-	rnn->_prev_layers_w[o][0][i][j] = rnn->_layers_w[o][0][i][j];
-	new_delta_w =  
-	  -_learning_rate * rnn->_layers_gradient_w[o][0][i][j] +
-	  (momentum_term * _layers_old_deltas_w[o][0][i][j]) -
-	  (ni * rnn->_layers_w[o][0][i][j]);
-	
-	rnn->_layers_w[o][0][i][j] += new_delta_w;
-	_layers_old_deltas_w[o][0][i][j] = new_delta_w;
-	
-      }
+  // backtracking line search, until sufficient decrease
+  const double c = 1e-4;
+  const int max_trials = 20;
+  double step = 1., error = _error;
+  bool accepted = false;
+  for(int trial=0; trial<max_trials && !accepted; ++trial, step *= .5) {
+    for(int p=0; p<n; ++p)
+      w[p] = _w0[p] + step * direction[p];
+    rnn->transposeFoldingWeights();
+    error = rnn->computeLoss(rnn->_line_search_set) + ni/2 * rnn->computeWeightsNorm();
+    accepted = error <= _error + c * step * slope;
+  }
+
+  if(accepted) {
+    // the weight difference now, the gradient one at the next update
+    if(_size == _m) {
+      _first = (_first + 1) % _m;
+      --_size;
     }
-    
-    for(int k=1; k<_r; k++) {
-      for(int i=0; i<_lnunits[k-1]+1; i++) {
-	for(int j=0; j<_lnunits[k]; j++) {
-	  rnn->_prev_layers_w[o][k][i][j] = rnn->_layers_w[o][k][i][j];
-	  new_delta_w =  
-	    -_learning_rate * rnn->_layers_gradient_w[o][k][i][j] +
-	    (momentum_term * _layers_old_deltas_w[o][k][i][j]) -
-	    (ni * rnn->_layers_w[o][k][i][j]);
-	  
-	  rnn->_layers_w[o][k][i][j] += new_delta_w;
-	  _layers_old_deltas_w[o][k][i][j] = new_delta_w;
-
-	}
-      }
+    G* s_new = s(_size);
+    G* y_new = y(_size);
+    for(int p=0; p<n; ++p) {
+      s_new[p] = w[p] - _w0[p];
+      y_new[p] = -gradient[p];
     }
+    _pending = true;
+    _error = error;
+  } else {
+    // no decrease along this direction: stay and forget the history
+    std::copy(_w0.begin(), _w0.end(), w);
+    rnn->transposeFoldingWeights();
+    _size = 0;
   }
-  
+
+  T* new_w = rnn->updatedWeights();
+  if(new_w != w) {
+    // the net keeps the current weights
+    std::copy(w, w + n, new_w);
+    std::copy(_w0.begin(), _w0.end(), w);
+  }
+  _w0.assign(new_w, new_w + n);
 }
 
 #endif // _ERROR_MINIMIZATION_PROCEDURE_H
@@ -26,52 +26,289 @@
 
 #include <cassert>
 #include <algorithm>
+#include <functional>
 using namespace std;
 
-Instance::Skeleton::Skeleton(Domain domain): _i(-1), _o(-1), _norient(num_orientations(domain)) {
-  assert(_norient > 0);
-  
-  _orientations = new DPAG*[_norient];
-  _top_orders = new vector<int>[_norient];
-  
-  for(uint i=0; i<_norient; ++i)
-    _orientations[i] = NULL;
+std::mutex Instance::Skeleton::_mutex;
+Instance::Skeleton::LRU Instance::Skeleton::_lru;
+size_t Instance::Skeleton::_bytes = 0;
+size_t Instance::Skeleton::_budget = 0;
+
+size_t Instance::Orientation::bytes() const {
+  size_t bytes = sizeof(Orientation) + graph.bytes() + order.capacity()*sizeof(int) +
+    levels.capacity()*sizeof(vector<int>);
+  for(uint l=0; l<levels.size(); ++l)
+    bytes += levels[l].capacity()*sizeof(int);
 
+  return bytes;
+}
+
+Instance::Skeleton::Skeleton(Domain domain, uint nnodes):
+  _domain(domain), _nnodes(nnodes), _i(-1), _o(-1), _norient(num_orientations(domain)), _rows(0), _cols(0),
+  _orientations(_norient), _lru_pos(_norient) {
+  assert(_norient > 0);
 }
 
 Instance::Skeleton::~Skeleton() {
-  for(uint i=0; i<_norient; ++i)
-    delete _orientations[i];
-  delete[] _orientations;  
-  delete[] _top_orders;
+  {
+    lock_guard<mutex> lock(_mutex);
+    for(uint i=0; i<_norient; ++i)
+      if(_orientations[i]) {
+	_bytes -= _orientations[i]->bytes();
+	_lru.erase(_lru_pos[i]);
+      }
+  }
 }
 
+DPAG* Instance::Skeleton::derive(uint index) const {
+  DPAG* dpag = new DPAG(_nnodes);
+
+  switch(_domain) {
+  case SEQUENCE:
+  case LINEARCHAIN:
+    // make the connections go from right to left
+    // to emulate RNN unfolding from left to right,
+    // i.e. reverse topological sort, then (linear
+    // chains) the other way round
+    if(index == 0)
+      for(uint i=_nnodes-1; i>0; --i)
+	boost::add_edge(i, i-1, EdgeProperty(0), *dpag);
+    else
+      for(uint i=0; i<_nnodes-1; ++i)
+	boost::add_edge(i, i+1, EdgeProperty(0), *dpag);
+    break;
+  case DOAG:
+    delete dpag;
+    dpag = new DPAG;
+    _base.to_dpag(dpag);
+    break;
+  case UG:
+    /*
+     * the first orientation goes from each node to the next and to its
+     * neighbours, the second from each node to the previous and to the
+     * nodes having it as a neighbour, in decreasing order
+     */
+    if(index == 0) {
+      for(uint v=0; v<_nnodes-1; ++v) {
+	vector<uint> children;
+	for(int c=_base.out_begin(v); c<_base.out_end(v); ++c)
+	  children.push_back(_base.target(c));
+
+	int edge_index = 0;
+	if(!children.size()) {
+	  boost::add_edge(v, v+1, EdgeProperty(edge_index), *dpag);
+	} else {
+	  sort(children.begin(), children.end());
+
+	  if(children.front() == v+1)
+	    edge_index++; 
+	  else 
+	    boost::add_edge(v, v+1, EdgeProperty(edge_index++), *dpag);
+	 
+	  for(uint i=0; i<children.size(); i++)
+	    boost::add_edge(v, children[i], EdgeProperty(edge_index++), *dpag);
+	}
+      }
+    } else {
+      vector<vector<int> > r_edges(_nnodes);
+      for(uint v=0; v<_nnodes; ++v)
+	for(int c=_base.out_begin(v); c<_base.out_end(v); ++c)
+	  r_edges[_base.target(c)].push_back(v);
+
+      for(uint v=1; v<_nnodes; ++v) {
+	vector<int>& parents = r_edges[v];
+	int edge_index = 0;
+	if(!parents.size()) {
+	  boost::add_edge(v, v-1, EdgeProperty(edge_index), *dpag);
+	} else {
+	  sort(parents.begin(), parents.end(), greater<int>());
+
+	  if((uint)parents.front() == v-1)
+	    edge_index++; 
+	  else 
+	    boost::add_edge(v, v-1, EdgeProperty(edge_index++), *dpag);
+	 
+	  for(uint i=0; i<parents.size(); i++)
+	    boost::add_edge(v, parents[i], EdgeProperty(edge_index++), *dpag);
+	}
+      }
+    }
+    break;
+  case GRID2D: {
+    const char* directions[] = { "nwse", "senw", "nesw", "swne" };
+    build_grid(directions[index], _rows, _cols, dpag);
+    break;
+  }
+  default:
+    assert(false);
+  }
+
+  return dpag;
+}
 
-void Instance::Skeleton::orientation(uint index, DPAG* dpag) {
+Instance::OrientationRef Instance::Skeleton::orientation(uint index) const {
   assert(index>=0 && index<_norient);
 
-  int mi = max_indegree(*dpag);
-  int mo = max_outdegree(*dpag);
-  if(_i < mi) _i = mi;
-  if(_o < mo) _o = mo;
+  lock_guard<mutex> lock(_mutex);
+  if(_orientations[index]) {
+    _lru.splice(_lru.begin(), _lru, _lru_pos[index]);
+    return _orientations[index];
+  }
 
-  if(_orientations[index] != NULL)
-    delete _orientations[index];
-  _orientations[index] = dpag;
-  
-  _top_orders[index] = topological_sort(*(_orientations[index]));
+  Orientation* orientation = new Orientation;
+  if(!_stored.empty()) {
+    assert(_stored.size() == _norient);
+    // kept with its topological order, only the levels are computed
+    orientation->graph = _stored[index];
+    orientation->order.assign(_stored_orders[index], _stored_orders[index] + _nnodes);
+    orientation->levels = topological_levels(orientation->graph, orientation->order);
+  } else {
+    // derive the DPAG, it is only
+    // needed to get the compact form
+    DPAG* dpag = derive(index);
+    orientation->order = topological_sort(*dpag);
+    orientation->levels = topological_levels(*dpag, orientation->order);
+    orientation->graph = CSRGraph(*dpag, true);
+    delete dpag;
+  }
+
+  _orientations[index] = OrientationRef(orientation);
+  _lru.push_front(make_pair(this, index));
+  _lru_pos[index] = _lru.begin();
+  _bytes += orientation->bytes();
+  evict();
+
+  return _orientations[index];
 }
 
-DPAG* Instance::orientation(uint index) {
-  assert(index>=0 && index<_skel->_norient);
-  
-  return _skel->_orientations[index];
+void Instance::Skeleton::evict() {
+  // the most recently used orientation is always kept,
+  // the others are released by those still using them
+  while(_budget && _bytes > _budget && _lru.size() > 1) {
+    const Skeleton* skel = _lru.back().first;
+    uint index = _lru.back().second;
+    _bytes -= skel->_orientations[index]->bytes();
+    skel->_orientations[index].reset();
+    _lru.pop_back();
+  }
 }
 
-vector<int> Instance::topological_order(uint index) const {
+void Instance::Skeleton::degrees(int& in, int& out) {
+  {
+    lock_guard<mutex> lock(_mutex);
+    in = _i;
+    out = _o;
+  }
+  if(in >= 0)
+    return;
+
+  // each node of a sequence has a child and a parent but the ends,
+  // an inner cell of a grid has a neighbour along each dimension
+  if(_domain == SEQUENCE || _domain == LINEARCHAIN)
+    in = out = _nnodes > 1;
+  else if(_domain == GRID2D)
+    in = out = (_rows > 1) + (_cols > 1);
+  else
+    // the orientations are derived out of the lock, which they take
+    for(uint o=0; o<_norient; ++o) {
+      OrientationRef oriented = orientation(o);
+      const CSRGraph& graph = oriented->graph;
+      for(int t=0; t<graph.num_vertices(); ++t) {
+	in = max(in, graph.in_end(t) - graph.in_begin(t));
+	out = max(out, graph.out_end(t) - graph.out_begin(t));
+      }
+    }
+
+  // threads computing them at the same time find the same values
+  lock_guard<mutex> lock(_mutex);
+  _i = in;
+  _o = out;
+}
+
+void Instance::orientations_budget(size_t bytes) {
+  lock_guard<mutex> lock(Skeleton::_mutex);
+  Skeleton::_budget = bytes;
+  Skeleton::evict();
+}
+
+int Instance::children(uint o, int t, int* c) const {
+  assert(implicit());
+  int nc = 0;
+  if(_domain != GRID2D) {
+    // the edges go from right to left in the first orientation
+    int child = o?t+1:t-1;
+    if(child >= 0 && child < (int)num_nodes())
+      c[nc++] = child;
+    return nc;
+  }
+
+  // the neighbours of cell (i,j) in the direction of the orientation:
+  // the one on the same row comes first, as the edges of the grid are
+  // numbered (see build_grid)
+  const int rows = grid_rows(), cols = grid_cols();
+  const int i = t/cols, j = t%cols;
+  int di, dj;
+  grid_direction(o, di, dj);
+
+  if(j+dj >= 0 && j+dj < cols)
+    c[nc++] = i*cols + j+dj;
+  if(i+di >= 0 && i+di < rows)
+    c[nc++] = (i+di)*cols + j;
+
+  return nc;
+}
+
+uint Instance::num_levels(uint o) const {
+  assert(implicit());
+  return _domain == GRID2D?grid_rows() + grid_cols() - 1:num_nodes();
+}
+
+int Instance::level_size(uint o, uint l) const {
+  assert(implicit() && l<num_levels(o));
+  if(_domain != GRID2D)
+    return 1;
+
+  const int cols = grid_cols();
+  return min(grid_rows()-1, (int)l) - max(0, (int)l-cols+1) + 1;
+}
+
+int Instance::level_node(uint o, uint l, int k) const {
+  assert(implicit() && k<level_size(o, l));
+  if(_domain != GRID2D)
+    return o?num_nodes()-1-l:l;
+
+  /*
+   * the height of cell (i,j) is its distance from the corner the
+   * orientation ends in, i.e. the sum of its distances (a,b) from
+   * the last row and column visited: cells with a+b == l form the
+   * l-th anti-diagonal wavefront
+   */
+  const int rows = grid_rows(), cols = grid_cols();
+  int di, dj;
+  grid_direction(o, di, dj);
+  const int a = max(0, (int)l-cols+1) + k;
+  const int i = di>0?rows-1-a:a;
+  const int j = dj>0?cols-1-(l-a):l-a;
+
+  return i*cols+j;
+}
+
+int Instance::root(uint o) const {
+  // the highest node of implicit instances is alone in its level
+  if(implicit())
+    return level_node(o, num_levels(o)-1, 0);
+
+  return oriented(o)->order[0];
+}
+
+shared_ptr<DPAG> Instance::orientation(uint index) const {
   assert(index>=0 && index<_skel->_norient);
 
-  return _skel->_top_orders[index];
+  // not cached: it would be kept out of the budget of the orientations
+  shared_ptr<DPAG> dpag(new DPAG);
+  oriented(index)->graph.to_dpag(dpag.get());
+  
+  return dpag;
 }
 
 void Instance::print(ostream& os) {
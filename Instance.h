@@ -31,6 +31,9 @@
 
 #include <string>
 #include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <iostream>
 
 class InstanceParser;
@@ -60,6 +63,24 @@ class Instance {
   // the list of nodes in the structure, indexed by their index in the graph
   std::vector<Node*> _nodes;
 
+ public:
+  /*
+    An orientation of the skeleton, ready to be processed: its compact
+    form, a topological order of its nodes and the nodes grouped by height
+  */
+  struct Orientation {
+    CSRGraph graph;
+    std::vector<int> order;
+    // nodes which can be processed together, leaves first
+    std::vector<std::vector<int> > levels;
+
+    // memory held, in bytes
+    size_t bytes() const;
+  };
+  // holding it keeps the orientation alive, even if evicted (see Skeleton)
+  typedef std::shared_ptr<const Orientation> OrientationRef;
+
+ private:
   /*
   
     Represents the skeleton of a data structure.
@@ -70,38 +91,76 @@ class Instance {
     structures, a skeleton object maintains a set of structures
     together with their topological orderings, one pair for every
     possible orientation that can be defined.
+
+    The orientations are derived from the base graph read (or, for
+    sequences and grids, from the number of nodes and the shape) the
+    first time they are asked for; those of sequences and grids only
+    when explicitly asked for (see Instance::implicit). All the skeletons share a memory
+    budget for their orientations: when it is exceeded, the least
+    recently used ones are dropped, to be derived again if needed.
   
   */
   class Skeleton {
-    int _i; // max indegree
-    int _o; // max outdegree
+    Domain _domain;
+    uint _nnodes;
+    // max indegree and outdegree, -1 until known (guarded by _mutex)
+    int _i, _o;
 
-    /*
-      cache for the set of possible oriented structures with their
-      corresponding topological orderings
-    
-      NOTE: might implement lazy loading scheme
-    */
     uint _norient; // number of orientations
-    DPAG** _orientations; // each orientation can be defined as a DPAG
-    std::vector<int>* _top_orders;
+    // graph read, DOAG and UG only
+    CSRGraph _base;
+    // shape of the underlying grid, GRID2D only
+    int _rows, _cols;
+    // orientations kept elsewhere, with their topological orders,
+    // used instead of deriving them (see BinaryDataSet.h)
+    std::vector<CSRGraph> _stored;
+    std::vector<const int*> _stored_orders;
+
+    // the orientations derived so far and their place
+    // in the shared least recently used list
+    typedef std::list<std::pair<const Skeleton*, uint> > LRU;
+    mutable std::vector<OrientationRef> _orientations;
+    mutable std::vector<LRU::iterator> _lru_pos;
+
+    // shared among all the skeletons, guarded by _mutex
+    static std::mutex _mutex;
+    static LRU _lru; // most recently used first
+    static size_t _bytes, _budget;
+    static void evict();
+
+    DPAG* derive(uint) const;
 
     // prevent assignment and copy construction
     Skeleton(const Skeleton&);
     Skeleton& operator=(const Skeleton&);
     
   public:
-    Skeleton(Domain);
+    Skeleton(Domain, uint);
     ~Skeleton();
 
-    void orientation(uint, DPAG*);
+    void base(const DPAG& dpag) { _base = CSRGraph(dpag, true); }
+    void grid(int rows, int cols) { _rows = rows; _cols = cols; }
+    // the next orientation, a view which must outlive the skeleton
+    void stored(const CSRGraph& graph, const int* order) {
+      assert(_stored.size() < _norient && (uint)graph.num_vertices() == _nnodes);
+      _stored.push_back(graph);
+      _stored_orders.push_back(order);
+    }
+    OrientationRef orientation(uint) const;
+    // max indegree and outdegree, computed the first time
+    void degrees(int&, int&);
     
     friend class ::Instance;
   };
 
   Skeleton* _skel;
 
+  // the memory the views of the instance point to, if
+  // any, kept as long as the instance (see BinaryDataSet.h)
+  std::shared_ptr<const void> _storage;
+
   friend class InstanceParser;
+  friend class BinaryDataSetReader;
 
   // prevent assignment and copy-construction
   Instance(const Instance&);
@@ -168,22 +227,50 @@ class Instance {
   /* int node_input_dim() const { return _nodes[0]->_encodedeInput.size(); } */
   /* int node_output_dim() const { return _nodes[0]->_otargets.size(); } */
 
-  // skeleton based methods
-  int maximum_indegree() const { assert(_skel->_i>=0); return _skel->_i; }
-  int maximum_outdegree() const { assert(_skel->_o>=0); return _skel->_o; }
+  // skeleton based methods, the degrees are those
+  // of the orientations, which are derived to know them
+  int maximum_indegree() { int i, o; _skel->degrees(i, o); return i; }
+  int maximum_outdegree() { int i, o; _skel->degrees(i, o); return o; }
   
   uint num_orient() const { return _skel->_norient; }
+  // an orientation, derived if not available: to be kept
+  // while processing the instance instead of the DPAG
+  OrientationRef oriented(uint o) const {
+    assert(o>=0 && o<_skel->_norient);
+    return _skel->orientation(o);
+  }
   // TODO: throw exception
-  DPAG* orientation(uint);
-  DPAG** orientations() { return _skel->_orientations; }
+  // converted from the orientation on each call, owned by the caller
+  std::shared_ptr<DPAG> orientation(uint) const;
   // TODO: throw exception
-  std::vector<int> topological_order(uint) const;
-  const std::vector<int>* topological_orders() { return _skel->_top_orders; }
+  // copies, the orientation may be evicted afterwards (see oriented)
+  std::vector<int> topological_order(uint o) const { return oriented(o)->order; }
+  std::vector<std::vector<int> > levels(uint o) const { return oriented(o)->levels; }
+
+  /*
+    SEQUENCE, LINEARCHAIN and GRID2D: the connectivity of the orientations
+    follows from the number of nodes, or the shape of the grid, and is
+    computed from the indices of the nodes: processing them never
+    needs an orientation to be derived
+  */
+  bool implicit() const { return _domain == SEQUENCE || _domain == LINEARCHAIN || _domain == GRID2D; }
+  // implicit only: the children of node t (at most two), in
+  // the order of the positions of their edges, and their number
+  int children(uint o, int t, int* c) const;
+  // implicit only: the levels, leaves first, and the k-th node at height l
+  uint num_levels(uint o) const;
+  int level_size(uint o, uint l) const;
+  int level_node(uint o, uint l, int k) const;
+  // the super-source of an orientation, first in its topological order
+  int root(uint o) const;
+
+  // memory budget (bytes) of the orientations of all the instances, 0 for
+  // none (the default): set once by the programs, after reading the options
+  static void orientations_budget(size_t);
+  // GRID2D: node (i,j) has index i*grid_cols()+j
+  int grid_rows() const { assert(_skel->_rows>0); return _skel->_rows; }
+  int grid_cols() const { assert(_skel->_cols>0); return _skel->_cols; }
 
-  void resetNodeOutputActivations() {
-    for(std::vector<Node*>::iterator it=_nodes.begin(); it!=_nodes.end(); ++it)
-      (*it)->resetValues();
-  }
 
   void print(std::ostream& = std::cout);
 };
@@ -104,50 +104,30 @@ istream& InstanceParser::read_skeleton(istream& is) {
 }
 
 istream& InstanceParser::read_sequence(std::istream& is) {
-  Instance::Skeleton* skel = new Instance::Skeleton(_domain);
-  DPAG* sequence = new DPAG(_num_nodes);
-  
-  // make the connections go from right to left
-  // to emulate RNN unfolding from left to right,
-  // i.e. reverse topological sort
-  for(uint i=_num_nodes-1; i>0; --i)
-    boost::add_edge(i, i-1, EdgeProperty(0), *sequence);
-  
-  skel->orientation(0, sequence);
-  _instance->skeleton(skel);
+  // the connections are implied by the order of the nodes
+  _instance->skeleton(new Instance::Skeleton(_domain, _num_nodes));
 
   return is;
 }
 
 istream& InstanceParser::read_linear_chain(std::istream& is) {
   // skeleton is composed of two sequences, one right to left
-  // and the other from left to right
-  Instance::Skeleton* skel = new Instance::Skeleton(_domain);
-
-  DPAG* rlseq = new DPAG(_num_nodes);
-  for(uint i=_num_nodes-1; i>0; --i)
-    boost::add_edge(i, i-1, EdgeProperty(0), *rlseq);
-  skel->orientation(0, rlseq);
-
-  DPAG* lrseq = new DPAG(_num_nodes);
-  for(uint i=0; i<_num_nodes-1; ++i)
-    boost::add_edge(i, i+1, EdgeProperty(0), *lrseq);
-  skel->orientation(1, lrseq);
-
-  _instance->skeleton(skel);
+  // and the other from left to right, implied by the order
+  // of the nodes
+  _instance->skeleton(new Instance::Skeleton(_domain, _num_nodes));
   
   return is;
 }
 
 istream& InstanceParser::read_doag(std::istream& is) {
-  Instance::Skeleton* skel = new Instance::Skeleton(_domain);
+  Instance::Skeleton* skel = new Instance::Skeleton(_domain, _num_nodes);
 
   // move to the first non-empty line after node i/o
   is.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
   while(is.peek()=='\n')
     is.get();
   
-  DPAG* doag = new DPAG(_num_nodes);
+  DPAG doag(_num_nodes);
   string line;
   for(uint i=0; i<_num_nodes; ++i) {
     getline(is, line);
@@ -157,17 +137,18 @@ istream& InstanceParser::read_doag(std::istream& is) {
     int target;
     int eindex = 0;
     while(iss >> target)
-      boost::add_edge(v, target, EdgeProperty(eindex++), *doag);
+      boost::add_edge(v, target, EdgeProperty(eindex++), doag);
   }
 
-  skel->orientation(0, doag);
+  // the only orientation
+  skel->base(doag);
   _instance->skeleton(skel);
 
   return is;
 }
 
 istream& InstanceParser::read_ugraph(std::istream& is) {
-  Instance::Skeleton* skel = new Instance::Skeleton(_domain);
+  Instance::Skeleton* skel = new Instance::Skeleton(_domain, _num_nodes);
 
   // move to the first non-empty line after node i/o
   is.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
@@ -187,96 +168,23 @@ istream& InstanceParser::read_ugraph(std::istream& is) {
       boost::add_edge(v, target, EdgeProperty(eindex++), dpag);
   }
 
-  VertexId vertex_id = boost::get(boost::vertex_index, dpag);
-  vertexIt v_i, v_end;
-  outIter out_i, out_end, out_i1;
-
-  map<int, vector<int> > r_edges;
-  uint n_vertices = boost::num_vertices(dpag);
-  for(uint i=0; i<n_vertices; i++) {
-    r_edges[i] = vector<int>();
-  }
-
-  DPAG* d_dpag = new DPAG(n_vertices);
-  for(boost::tie(v_i, v_end) = boost::vertices(dpag); v_i!=v_end; ++v_i) {
-    vector<uint> children;
-    for(boost::tie(out_i, out_end)=boost::out_edges(*v_i, dpag);
-	out_i!=out_end; ++out_i) {
-      children.push_back(boost::target(*out_i, dpag));
-      r_edges[boost::target(*out_i, dpag)].push_back(boost::source(*out_i, dpag));
-    }
-    if(vertex_id[*v_i] != n_vertices-1) {
-      int edge_index = 0;
-      if(!children.size()) {
-	boost::add_edge(vertex_id[*v_i], vertex_id[*v_i]+1, EdgeProperty(edge_index), *d_dpag);
-      } else {
-	sort(children.begin(), children.end());
-
-	if(children.front() == vertex_id[*v_i]+1)
-	  edge_index++; 
-	else 
-	  boost::add_edge(vertex_id[*v_i], vertex_id[*v_i]+1, EdgeProperty(edge_index++), *d_dpag);
-	 
-	for(uint i=0; i<children.size(); i++)
-	  boost::add_edge(vertex_id[*v_i], children[i], EdgeProperty(edge_index++), *d_dpag);
-      }
-    }
-  }
-  
-  DPAG* r_dpag = new DPAG(n_vertices);
-  for(boost::tie(v_i, v_end) = boost::vertices(dpag); v_i!=v_end; ++v_i) {
-    if(!vertex_id[*v_i])
-      continue;
-    map<int, vector<int> >::iterator it = r_edges.find(vertex_id[*v_i]);
-    if(it != r_edges.end()) {
-      int edge_index = 0;
-      if(!(*it).second.size()) {
-	boost::add_edge(vertex_id[*v_i], vertex_id[*v_i]-1, EdgeProperty(edge_index), *r_dpag);
-      } else {
-	sort((*it).second.begin(), (*it).second.end(), greater<int>());
-
-	if((uint)(*it).second.front() == vertex_id[*v_i]-1)
-	  edge_index++; 
-	else 
-	  boost::add_edge(vertex_id[*v_i], vertex_id[*v_i]-1, EdgeProperty(edge_index++), *r_dpag);
-	 
-	for(uint i=0; i<(*it).second.size(); i++)
-	  boost::add_edge(vertex_id[*v_i], ((*it).second)[i], EdgeProperty(edge_index++), *r_dpag);
-      }
-    }
-  }
-
-  skel->orientation(0, d_dpag);
-  skel->orientation(1, r_dpag);
+  // the two orientations are derived from it
+  skel->base(dpag);
   _instance->skeleton(skel);
   
   return is;
 }
 
 istream& InstanceParser::read_grid2d(std::istream& is) {
-  Instance::Skeleton* skel = new Instance::Skeleton(_domain);
+  Instance::Skeleton* skel = new Instance::Skeleton(_domain, _num_nodes);
 
-  // read the number of rows and columns
+  // read the number of rows and columns, the
+  // four orientations are derived from them
   int rows, cols;
   is >> rows >> cols;
   assert(rows>0 && cols>0);
   assert(_num_nodes == (uint)rows*cols);
-
-  DPAG* nwse_grid = new DPAG(_num_nodes);
-  build_grid("nwse", rows, cols, nwse_grid);
-  skel->orientation(0, nwse_grid);
-
-  DPAG* senw_grid = new DPAG(_num_nodes);
-  build_grid("senw", rows, cols, senw_grid);
-  skel->orientation(1, senw_grid);
-
-  DPAG* nesw_grid = new DPAG(_num_nodes);
-  build_grid("nesw", rows, cols, nesw_grid);
-  skel->orientation(2, nesw_grid);
-
-  DPAG* swne_grid = new DPAG(_num_nodes);
-  build_grid("swne", rows, cols, swne_grid);
-  skel->orientation(3, swne_grid);
+  skel->grid(rows, cols);
 
   _instance->skeleton(skel);
   
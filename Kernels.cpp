@@ -0,0 +1,364 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "Kernels.h"
+
+/*
+  The vectorised versions are compiled for their own target
+  independently of the compiler flags, so that the same binary
+  can run on any x86-64 CPU and pick the best at runtime.
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/*** Scalar fallback ***/
+
+template<typename T>
+static T dot_scalar(int n, const T* x, const T* y) {
+  T sum = 0;
+  for(int i=0; i<n; ++i)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+template<typename T, typename U>
+static void axpy_scalar(int n, U a, const T* x, U* y) {
+  for(int i=0; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+#ifdef X86_KERNELS
+
+/*** SSE2 ***/
+
+__attribute__((target("sse2")))
+static float sdot_sse(int n, const float* x, const float* y) {
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  int i = 0;
+  for(; i+8<=n; i+=8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x+i), _mm_loadu_ps(y+i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x+i+4), _mm_loadu_ps(y+i+4)));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+  float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for(; i<n; ++i)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+__attribute__((target("sse2")))
+static double ddot_sse(int n, const double* x, const double* y) {
+  __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+  int i = 0;
+  for(; i+4<=n; i+=4) {
+    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(x+i), _mm_loadu_pd(y+i)));
+    acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(x+i+2), _mm_loadu_pd(y+i+2)));
+  }
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+  double sum = lanes[0] + lanes[1];
+  for(; i<n; ++i)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+__attribute__((target("sse2")))
+static void saxpy_sse(int n, float a, const float* x, float* y) {
+  const __m128 va = _mm_set1_ps(a);
+  int i = 0;
+  for(; i+4<=n; i+=4)
+    _mm_storeu_ps(y+i, _mm_add_ps(_mm_loadu_ps(y+i), _mm_mul_ps(va, _mm_loadu_ps(x+i))));
+  for(; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+__attribute__((target("sse2")))
+static void daxpy_sse(int n, double a, const double* x, double* y) {
+  const __m128d va = _mm_set1_pd(a);
+  int i = 0;
+  for(; i+2<=n; i+=2)
+    _mm_storeu_pd(y+i, _mm_add_pd(_mm_loadu_pd(y+i), _mm_mul_pd(va, _mm_loadu_pd(x+i))));
+  for(; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+// single precision x widened to the double precision of y
+__attribute__((target("sse2")))
+static void dsaxpy_sse(int n, double a, const float* x, double* y) {
+  const __m128d va = _mm_set1_pd(a);
+  int i = 0;
+  for(; i+4<=n; i+=4) {
+    const __m128 vx = _mm_loadu_ps(x+i);
+    _mm_storeu_pd(y+i, _mm_add_pd(_mm_loadu_pd(y+i), _mm_mul_pd(va, _mm_cvtps_pd(vx))));
+    _mm_storeu_pd(y+i+2, _mm_add_pd(_mm_loadu_pd(y+i+2), _mm_mul_pd(va, _mm_cvtps_pd(_mm_movehl_ps(vx, vx)))));
+  }
+  for(; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+/*** AVX2 + FMA ***/
+
+__attribute__((target("avx2,fma")))
+static float sdot_avx2(int n, const float* x, const float* y) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for(; i+16<=n; i+=16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x+i), _mm256_loadu_ps(y+i), acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x+i+8), _mm256_loadu_ps(y+i+8), acc1);
+  }
+  for(; i+8<=n; i+=8)
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x+i), _mm256_loadu_ps(y+i), acc0);
+
+  __m256 acc = _mm256_add_ps(acc0, acc1);
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  float sum = _mm_cvtss_f32(s);
+  for(; i<n; ++i)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static double ddot_avx2(int n, const double* x, const double* y) {
+  __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+  int i = 0;
+  for(; i+8<=n; i+=8) {
+    acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i), _mm256_loadu_pd(y+i), acc0);
+    acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i+4), _mm256_loadu_pd(y+i+4), acc1);
+  }
+  for(; i+4<=n; i+=4)
+    acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(x+i), _mm256_loadu_pd(y+i), acc0);
+
+  __m256d acc = _mm256_add_pd(acc0, acc1);
+  __m128d s = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+  s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+  double sum = _mm_cvtsd_f64(s);
+  for(; i<n; ++i)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static void saxpy_avx2(int n, float a, const float* x, float* y) {
+  const __m256 va = _mm256_set1_ps(a);
+  int i = 0;
+  for(; i+8<=n; i+=8)
+    _mm256_storeu_ps(y+i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x+i), _mm256_loadu_ps(y+i)));
+  for(; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+__attribute__((target("avx2,fma")))
+static void daxpy_avx2(int n, double a, const double* x, double* y) {
+  const __m256d va = _mm256_set1_pd(a);
+  int i = 0;
+  for(; i+4<=n; i+=4)
+    _mm256_storeu_pd(y+i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x+i), _mm256_loadu_pd(y+i)));
+  for(; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+__attribute__((target("avx2,fma")))
+static void dsaxpy_avx2(int n, double a, const float* x, double* y) {
+  const __m256d va = _mm256_set1_pd(a);
+  int i = 0;
+  for(; i+4<=n; i+=4)
+    _mm256_storeu_pd(y+i, _mm256_fmadd_pd(va, _mm256_cvtps_pd(_mm_loadu_ps(x+i)), _mm256_loadu_pd(y+i)));
+  for(; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+/*** AVX-512 ***/
+
+__attribute__((target("avx512f")))
+static float sdot_avx512(int n, const float* x, const float* y) {
+  __m512 acc = _mm512_setzero_ps();
+  int i = 0;
+  for(; i+16<=n; i+=16)
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(x+i), _mm512_loadu_ps(y+i), acc);
+  if(i < n) {
+    // masked loads for the remainder
+    const __mmask16 rem = (__mmask16)((1u << (n-i)) - 1);
+    acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(rem, x+i), _mm512_maskz_loadu_ps(rem, y+i), acc);
+  }
+
+  // halve down to the horizontal add of the AVX2 kernel: the
+  // extractions are zero-masked, as the unmasked ones and the
+  // reductions built on them read an undefined vector
+  const __m512d d = _mm512_castps_pd(acc);
+  __m256 h = _mm256_add_ps(_mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, d, 0)),
+			   _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, d, 1)));
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx512f")))
+static double ddot_avx512(int n, const double* x, const double* y) {
+  __m512d acc = _mm512_setzero_pd();
+  int i = 0;
+  for(; i+8<=n; i+=8)
+    acc = _mm512_fmadd_pd(_mm512_loadu_pd(x+i), _mm512_loadu_pd(y+i), acc);
+  if(i < n) {
+    const __mmask8 rem = (__mmask8)((1u << (n-i)) - 1);
+    acc = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(rem, x+i), _mm512_maskz_loadu_pd(rem, y+i), acc);
+  }
+
+  __m256d h = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xff, acc, 0),
+			    _mm512_maskz_extractf64x4_pd(0xff, acc, 1));
+  __m128d s = _mm_add_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+  s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+  return _mm_cvtsd_f64(s);
+}
+
+__attribute__((target("avx512f")))
+static void saxpy_avx512(int n, float a, const float* x, float* y) {
+  const __m512 va = _mm512_set1_ps(a);
+  int i = 0;
+  for(; i+16<=n; i+=16)
+    _mm512_storeu_ps(y+i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x+i), _mm512_loadu_ps(y+i)));
+  if(i < n) {
+    const __mmask16 rem = (__mmask16)((1u << (n-i)) - 1);
+    _mm512_mask_storeu_ps(y+i, rem, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(rem, x+i),
+						     _mm512_maskz_loadu_ps(rem, y+i)));
+  }
+}
+
+__attribute__((target("avx512f")))
+static void daxpy_avx512(int n, double a, const double* x, double* y) {
+  const __m512d va = _mm512_set1_pd(a);
+  int i = 0;
+  for(; i+8<=n; i+=8)
+    _mm512_storeu_pd(y+i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x+i), _mm512_loadu_pd(y+i)));
+  if(i < n) {
+    const __mmask8 rem = (__mmask8)((1u << (n-i)) - 1);
+    _mm512_mask_storeu_pd(y+i, rem, _mm512_fmadd_pd(va, _mm512_maskz_loadu_pd(rem, x+i),
+						    _mm512_maskz_loadu_pd(rem, y+i)));
+  }
+}
+
+// the conversions are zero-masked, as in the reductions above
+__attribute__((target("avx512f")))
+static void dsaxpy_avx512(int n, double a, const float* x, double* y) {
+  const __m512d va = _mm512_set1_pd(a);
+  int i = 0;
+  for(; i+8<=n; i+=8)
+    _mm512_storeu_pd(y+i, _mm512_fmadd_pd(va, _mm512_maskz_cvtps_pd(0xff, _mm256_loadu_ps(x+i)),
+					  _mm512_loadu_pd(y+i)));
+  if(i < n) {
+    // the floats of the remainder in the lower half of a masked load
+    const __mmask8 rem = (__mmask8)((1u << (n-i)) - 1);
+    const __m512d d = _mm512_castps_pd(_mm512_maskz_loadu_ps(rem, x+i));
+    const __m256 vx = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, d, 0));
+    _mm512_mask_storeu_pd(y+i, rem, _mm512_fmadd_pd(va, _mm512_maskz_cvtps_pd(0xff, vx),
+						    _mm512_maskz_loadu_pd(rem, y+i)));
+  }
+}
+
+#endif // X86_KERNELS
+
+/*** Runtime dispatch ***/
+
+struct KernelTable {
+  InstructionSet isa;
+  float (*sdot)(int, const float*, const float*);
+  double (*ddot)(int, const double*, const double*);
+  void (*saxpy)(int, float, const float*, float*);
+  void (*daxpy)(int, double, const double*, double*);
+  void (*dsaxpy)(int, double, const float*, double*);
+};
+
+static const KernelTable kernel_tables[] = {
+  { SCALAR_ISA, dot_scalar<float>, dot_scalar<double>,
+    axpy_scalar<float, float>, axpy_scalar<double, double>, axpy_scalar<float, double> },
+#ifdef X86_KERNELS
+  { SSE_ISA, sdot_sse, ddot_sse, saxpy_sse, daxpy_sse, dsaxpy_sse },
+  { AVX2_ISA, sdot_avx2, ddot_avx2, saxpy_avx2, daxpy_avx2, dsaxpy_avx2 },
+  { AVX512_ISA, sdot_avx512, ddot_avx512, saxpy_avx512, daxpy_avx512, dsaxpy_avx512 },
+#endif
+};
+
+InstructionSet supported_instruction_set() {
+#ifdef X86_KERNELS
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return AVX512_ISA;
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return AVX2_ISA;
+  if(__builtin_cpu_supports("sse2"))
+    return SSE_ISA;
+#endif
+  return SCALAR_ISA;
+}
+
+// default to the best instruction set supported by the host
+static const KernelTable* kernels = &kernel_tables[supported_instruction_set()];
+
+InstructionSet instruction_set() {
+  return kernels->isa;
+}
+
+InstructionSet select_instruction_set(InstructionSet isa) {
+  InstructionSet supported = supported_instruction_set();
+  if(isa == AUTO_ISA || isa > supported)
+    isa = supported;
+
+  kernels = &kernel_tables[isa];
+  return isa;
+}
+
+const char* instruction_set_name(InstructionSet isa) {
+  switch(isa) {
+  case SCALAR_ISA: return "SCALAR";
+  case SSE_ISA: return "SSE";
+  case AVX2_ISA: return "AVX2";
+  case AVX512_ISA: return "AVX512";
+  default: return "AUTO";
+  }
+}
+
+float dot(int n, const float* x, const float* y) {
+  return kernels->sdot(n, x, y);
+}
+
+double dot(int n, const double* x, const double* y) {
+  return kernels->ddot(n, x, y);
+}
+
+void axpy(int n, float a, const float* x, float* y) {
+  kernels->saxpy(n, a, x, y);
+}
+
+void axpy(int n, double a, const double* x, double* y) {
+  kernels->daxpy(n, a, x, y);
+}
+
+void axpy(int n, double a, const float* x, double* y) {
+  kernels->dsaxpy(n, a, x, y);
+}
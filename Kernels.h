@@ -0,0 +1,131 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _KERNELS_H_
+#define _KERNELS_H_
+
+/*
+  Instruction sets for which the vector primitives below have
+  a hand-vectorised version. The one in use is selected at runtime
+  according to what the host CPU supports, unless a specific one is
+  requested (e.g. to test the scalar fallback).
+*/
+enum InstructionSet { SCALAR_ISA=0, SSE_ISA, AVX2_ISA, AVX512_ISA, AUTO_ISA };
+
+// Best instruction set supported by the host
+InstructionSet supported_instruction_set();
+
+// Instruction set of the kernels in use
+InstructionSet instruction_set();
+
+// Select the kernels for the given instruction set, or for the best
+// supported by the host if this is not. Return the one selected.
+InstructionSet select_instruction_set(InstructionSet = AUTO_ISA);
+
+const char* instruction_set_name(InstructionSet);
+
+/*
+  Vector primitives
+
+  dot:  return sum_i x[i]*y[i]
+  axpy: y += a*x
+
+  The overloads are dispatched to the selected instruction set:
+  those for vectors of the same floating point type and the axpy
+  of float vectors into double ones (e.g. float activations into
+  double gradient components, see gemm_nn and gemm_tn below).
+  The templates are the scalar versions for the other types.
+*/
+float dot(int, const float*, const float*);
+double dot(int, const double*, const double*);
+
+void axpy(int, float, const float*, float*);
+void axpy(int, double, const double*, double*);
+void axpy(int, double, const float*, double*);
+
+template<typename T>
+T dot(int n, const T* x, const T* y) {
+  T sum = 0;
+  for(int i=0; i<n; ++i)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+template<typename T, typename U>
+void axpy(int n, U a, const T* x, U* y) {
+  for(int i=0; i<n; ++i)
+    y[i] += a * x[i];
+}
+
+/*
+  Dense matrix kernels used to propagate blocks of nodes
+  through the layers of the networks.
+
+  Matrices are stored by rows, with an explicit leading dimension
+  (row stride), and the product is accumulated into the result:
+
+    C += alpha * op(A) * op(B)
+
+  where C is m x n and op(A), op(B) are m x k, k x n.
+  The type of the result can be wider than that of the operands
+  (e.g. float activations and double gradient components).
+  With the scalar kernels, every element of C accumulates its terms
+  in increasing order of k.
+*/
+
+// C += alpha * A * B
+template<typename T, typename U>
+void gemm_nn(int m, int n, int k, U alpha,
+	     const T* a, int lda, const T* b, int ldb, U* c, int ldc) {
+  for(int i=0; i<m; ++i) {
+    U* c_i = c + i*ldc;
+    for(int p=0; p<k; ++p)
+      axpy(n, U(alpha * a[i*lda + p]), b + p*ldb, c_i);
+  }
+}
+
+// C += alpha * A * B^T
+template<typename T, typename U>
+void gemm_nt(int m, int n, int k, U alpha,
+	     const T* a, int lda, const T* b, int ldb, U* c, int ldc) {
+  for(int i=0; i<m; ++i) {
+    const T* a_i = a + i*lda;
+    for(int j=0; j<n; ++j)
+      c[i*ldc + j] += alpha * dot(k, a_i, b + j*ldb);
+  }
+}
+
+// C += alpha * A^T * B
+template<typename T, typename U>
+void gemm_tn(int m, int n, int k, U alpha,
+	     const T* a, int lda, const T* b, int ldb, U* c, int ldc) {
+  for(int p=0; p<k; ++p) {
+    const T* a_p = a + p*lda;
+    const T* b_p = b + p*ldb;
+    for(int i=0; i<m; ++i)
+      axpy(n, U(alpha * a_p[i]), b_p, c + i*ldc);
+  }
+}
+
+#endif // _KERNELS_H_
@@ -0,0 +1,117 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "LearningRateSchedule.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+using namespace std;
+
+LearningRateSchedule* LearningRateSchedule::factory(const LRSchedule& schedule, double eta, int epochs) {
+  Options* options = Options::instance();
+  
+  switch(schedule) {
+  case CONSTANT_LR:
+    return new ConstantLearningRate(eta);
+  case STEP_LR:
+    return new StepDecay(eta, options->learning_rate_decay(), options->learning_rate_step());
+  case EXPONENTIAL_LR:
+    return new ExponentialDecay(eta, options->learning_rate_decay());
+  case COSINE_LR:
+    return new CosineAnnealing(eta, options->learning_rate_min(), epochs);
+  case VOGL_LR:
+    return new VoglAcceleration(eta);
+  case PLATEAU_LR:
+    return new ReduceOnPlateau(eta, options->learning_rate_decay(),
+			       options->learning_rate_step(), options->learning_rate_min());
+  }
+
+  throw BadScheduleCreation("Unknown learning rate schedule");
+}
+
+double StepDecay::update(int epoch, double, double&, bool&) {
+  return _eta0 * pow(_decay, epoch / _step);
+}
+
+double ExponentialDecay::update(int epoch, double, double&, bool&) {
+  return _eta0 * pow(_decay, epoch);
+}
+
+double CosineAnnealing::update(int epoch, double, double&, bool&) {
+  if(epoch >= _epochs)
+    return _eta_min;
+  return _eta_min + (_eta0 - _eta_min) * (1 + cos(M_PI * epoch / _epochs)) / 2;
+}
+
+VoglAcceleration::VoglAcceleration(double eta):
+  LearningRateSchedule(eta), _prev_eta(eta), _prev_error(FLT_MAX) {}
+
+double VoglAcceleration::update(int, double curr_error, double& alpha, bool& restore_weights) {
+  double alpha_0 = 1e-1;
+  double beta = .5, epsilon = 1e-2;
+  double phi_additive = _prev_eta/100;
+
+  double curr_eta;
+
+  if(curr_error < _prev_error) {
+    curr_eta = phi_additive + _prev_eta;
+    if(curr_eta > 1)
+      curr_eta = 1;
+    alpha = alpha_0;
+    _prev_eta = curr_eta;
+    _prev_error = curr_error;
+  } else if(curr_error < (1 + epsilon) * _prev_error) {
+    curr_eta = beta * _prev_eta;
+    alpha = 0;
+    _prev_eta = curr_eta;
+    _prev_error = curr_error;
+  } else {
+    restore_weights = true;
+    curr_eta = beta * _prev_eta;
+    alpha = 0;
+  }
+
+  return curr_eta;
+}
+
+ReduceOnPlateau::ReduceOnPlateau(double eta, double decay, int patience, double eta_min):
+  LearningRateSchedule(eta), _eta(eta), _decay(decay), _eta_min(eta_min),
+  _patience(patience), _bad_epochs(0), _best_error(FLT_MAX) {}
+
+double ReduceOnPlateau::update(int, double error, double&, bool&) {
+  // improvements smaller than this fraction of the best error do not count
+  double threshold = 1e-4;
+
+  if(error < (1 - threshold) * _best_error) {
+    _best_error = error;
+    _bad_epochs = 0;
+  } else if(++_bad_epochs >= _patience) {
+    _eta = max(_eta * _decay, _eta_min);
+    _bad_epochs = 0;
+  }
+
+  return _eta;
+}
@@ -0,0 +1,150 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _LEARNING_RATE_SCHEDULE_H_
+#define _LEARNING_RATE_SCHEDULE_H_
+
+#include "Options.h"
+
+#include <string>
+#include <stdexcept>
+
+/*
+  Strategies to change the learning rate during training.
+
+  A schedule is created for each training run and asked, at the end of
+  every epoch, for the learning rate of the next one. Its state lives
+  in the object, so that different runs do not interfere.
+*/
+
+class LearningRateSchedule {
+ public:
+  virtual ~LearningRateSchedule() {}
+
+  // The learning rate for the epoch following the given one, knowing
+  // the error at its end. Adaptive schedules may also change the momentum
+  // term and ask to restore the weights before the last update.
+  virtual double update(int epoch, double error, double& alpha, bool& restore_weights) = 0;
+  // whether the schedule may ask to restore the weights (see Model::rollback)
+  virtual bool rollback() const { return false; }
+
+  class BadScheduleCreation: public std::logic_error {
+    public:
+      BadScheduleCreation(std::string msg): logic_error(msg) {}
+   };
+
+  // factory method: the schedule of the given type, starting
+  // from the given learning rate, for the given number of epochs
+  // (throws BadScheduleCreation)
+  static LearningRateSchedule* factory(const LRSchedule&, double, int);
+
+ protected:
+  LearningRateSchedule(double eta): _eta0(eta) {}
+  double _eta0; // initial learning rate
+};
+
+// the initial learning rate throughout
+class ConstantLearningRate: public LearningRateSchedule {
+ public:
+  double update(int, double, double&, bool&) { return _eta0; }
+
+ private:
+  ConstantLearningRate(double eta): LearningRateSchedule(eta) {}
+  friend class LearningRateSchedule;
+};
+
+// multiplied by decay every step epochs
+class StepDecay: public LearningRateSchedule {
+ public:
+  double update(int, double, double&, bool&);
+
+ private:
+  StepDecay(double eta, double decay, int step):
+    LearningRateSchedule(eta), _decay(decay), _step(step) {}
+  friend class LearningRateSchedule;
+
+  double _decay;
+  int _step;
+};
+
+// multiplied by decay every epoch
+class ExponentialDecay: public LearningRateSchedule {
+ public:
+  double update(int, double, double&, bool&);
+
+ private:
+  ExponentialDecay(double eta, double decay):
+    LearningRateSchedule(eta), _decay(decay) {}
+  friend class LearningRateSchedule;
+
+  double _decay;
+};
+
+// from the initial learning rate down to the minimum one
+// along half a cosine period over the training epochs
+class CosineAnnealing: public LearningRateSchedule {
+ public:
+  double update(int, double, double&, bool&);
+
+ private:
+  CosineAnnealing(double eta, double eta_min, int epochs):
+    LearningRateSchedule(eta), _eta_min(eta_min), _epochs(epochs) {}
+  friend class LearningRateSchedule;
+
+  double _eta_min;
+  int _epochs;
+};
+
+// Vogl adaptive acceleration (additive): increase the learning rate
+// while the error decreases, otherwise halve it and drop the momentum,
+// restoring the weights if the error has grown too much
+class VoglAcceleration: public LearningRateSchedule {
+ public:
+  double update(int, double, double&, bool&);
+  bool rollback() const { return true; }
+
+ private:
+  VoglAcceleration(double eta);
+  friend class LearningRateSchedule;
+
+  double _prev_eta, _prev_error;
+};
+
+// multiplied by decay once the error has not improved for step epochs,
+// not going below the minimum learning rate
+class ReduceOnPlateau: public LearningRateSchedule {
+ public:
+  double update(int, double, double&, bool&);
+
+ private:
+  ReduceOnPlateau(double eta, double decay, int patience, double eta_min);
+  friend class LearningRateSchedule;
+
+  double _eta, _decay, _eta_min;
+  int _patience, _bad_epochs;
+  double _best_error;
+};
+
+#endif // _LEARNING_RATE_SCHEDULE_H_
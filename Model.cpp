@@ -27,6 +27,51 @@
 #include "RecursiveNN.h"
 using namespace std;
 
+/*
+ * Instantiate a network with output activation function OA_Function
+ * and the floating point types selected in the options
+ */
+template<template<typename, typename> class EMP, class OA_Function, typename T, typename G>
+static Model* create(const string& netname) {
+  if(netname == "")
+    return new RecursiveNN<TanH, OA_Function, EMP, T, G>();
+  else
+    return new RecursiveNN<TanH, OA_Function, EMP, T, G>(netname.c_str());
+}
+
+/*
+ * Same, with the error minimization procedure selected in the options
+ */
+template<class OA_Function, typename T, typename G>
+static Model* create(const string& netname) {
+  switch(Options::instance()->optimizer()) {
+  case GRADIENT_DESCENT:
+    return create<GradientDescent, OA_Function, T, G>(netname);
+  case RMSPROP:
+    return create<RMSprop, OA_Function, T, G>(netname);
+  case ADAM:
+    return create<Adam, OA_Function, T, G>(netname);
+  case RPROP:
+    return create<Rprop, OA_Function, T, G>(netname);
+  case LIMITED_MEMORY_BFGS:
+    return create<LBFGS, OA_Function, T, G>(netname);
+  default:
+    return create<MGradientDescent, OA_Function, T, G>(netname);
+  }
+}
+
+template<class OA_Function>
+static Model* create(const string& netname) {
+  switch(Options::instance()->numeric_precision()) {
+  case SINGLE_PRECISION:
+    return create<OA_Function, float, float>(netname);
+  case MIXED_PRECISION:
+    return create<OA_Function, float, double>(netname);
+  default:
+    return create<OA_Function, double, double>(netname);
+  }
+}
+
 /*
  * TODO
  *
@@ -39,18 +84,10 @@ Model* Model::factory(const string& netname)
   
   Problem problem = Options::instance()->problem();
   
-  if(problem & BINARYCLASS) {
-    if(netname == "")
-      return new RecursiveNN<TanH, Sigmoid, MGradientDescent>();
-    else
-      return new RecursiveNN<TanH, Sigmoid, MGradientDescent>(netname.c_str());
-    
-  } else if(problem & (MULTICLASS | REGRESSION)) {
-    if(netname == "")
-      return new RecursiveNN<TanH, Linear, MGradientDescent>();
-    else
-      return new RecursiveNN<TanH, Linear, MGradientDescent>(netname.c_str());
-    
-  } else
+  if(problem & BINARYCLASS)
+    return create<Sigmoid>(netname);
+  else if(problem & (MULTICLASS | REGRESSION))
+    return create<Linear>(netname);
+  else
     throw BadModelCreation("Unknown problem type");
 }
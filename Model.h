@@ -47,8 +47,23 @@ class Model {
   virtual void propagateStructuredInput(Instance*) = 0;
   virtual void backPropagateError(Instance*) = 0;
 
+  // process a batch of instances at once
+  virtual void propagateStructuredInput(DataSet::const_iterator, DataSet::const_iterator) = 0;
+  virtual void backPropagateError(DataSet::const_iterator, DataSet::const_iterator) = 0;
+  // accumulate the gradient of the error over a range of instances,
+  // possibly sharing them among parallel workers (see Options.h)
+  virtual void accumulateGradient(DataSet::const_iterator, DataSet::const_iterator) = 0;
+  // online learning over a range of instances, one weight update
+  // after each of them, possibly by parallel workers (see Options.h)
+  virtual void trainOnline(DataSet::const_iterator, DataSet::const_iterator,
+			   float = .0, float = .0, float = .0) = 0;
+
   virtual void adjustWeights(float = .0, float = .0, float = .0) = 0;
-  virtual void restorePrevWeights() = 0;
+  virtual void enableRollback(bool = true) = 0;
+  // the instances on which procedures needing the error itself,
+  // not only its gradient, evaluate it (see LBFGS)
+  virtual void lineSearchSet(DataSet*) = 0;
+  virtual void rollback() = 0;
 
   virtual void saveParameters(const char*) = 0;
 
@@ -0,0 +1,251 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#ifndef _NODE_WORKSPACE_H_
+#define _NODE_WORKSPACE_H_
+
+#include "require.h"
+#include "Instance.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+/*
+  Activations and deltas buffers of a node, parameterised
+  on the floating point type used by the network.
+*/
+template<typename T>
+struct NodeActivations {
+  /*
+    Store ouput activations for each layer and for each folding part.
+    This implements the copy of every layer of the folding
+    part for every node of the structure processed (Goller 3.3.1),
+    because we need to store activations of every layer for each node,
+    and not the copy of weights of the unfolding part.
+  */
+  T*** _layers_activations;
+  T** _h_layers_activations;
+
+  /*
+    Store delta values at representation layer for each node, so
+    if a node have different immediate predecessors, its
+    delta values coming from predecessors can be summed up.
+    As reported in (Goller 3.3.2), during the computation
+    of delta values for each layer, their contribution to the
+    weight update can be computed (accumulated), so we do not need
+    to store them (except those from representation layer, as already observed).
+  */
+  T** _delta_lr;
+
+ NodeActivations(): _layers_activations(0), _h_layers_activations(0), _delta_lr(0) {}
+};
+
+/*
+  Activations and deltas buffers of a number of nodes in a
+  single aligned block. For each node, in turn: the
+  layers of the state transition functions of each orientation,
+  the deltas at the representation layer of each orientation and,
+  for IO-isomorph transductions, the layers of the output function.
+  Nodes are bound to their part of the block through the pointers of
+  their NodeActivations base, whose tables are also kept here.
+*/
+template<typename T>
+class NodeArena {
+  // each node begins on its own cache line
+  enum { alignment = 64 };
+
+  T* _data;
+  size_t _size;      // number of values, padding included
+  size_t _node_size; // number of values of a node, padding included
+  int _norient, _r, _s;
+  std::vector<int> _lnunits;
+  bool _ios_tr;
+  
+  // per node, the layers of each orientation, then the start of each
+  // layer, of each delta and of each output layer (the pointers tables)
+  std::vector<T**> _tables;
+  std::vector<T*> _rows;
+  int _nrows;
+  
+  // prevent copy construction and assignment
+  NodeArena(const NodeArena&);
+  NodeArena& operator=(const NodeArena&);
+
+ public:
+ NodeArena(): _data(0), _size(0), _node_size(0) {}
+  ~NodeArena() { free(_data); }
+
+  // (re)allocate a zeroed block for the given number of nodes, given
+  // the number of orientations and the architecture of the network
+  void allocate(int nnodes, int norient, const std::vector<int>& lnunits, int r, int s, bool ios_tr) {
+    _norient = norient; _lnunits = lnunits; _r = r; _s = s; _ios_tr = ios_tr;
+
+    size_t values = 0;
+    for(int k=0; k<_r; ++k)
+      values += _norient * _lnunits[k];
+    values += _norient * _lnunits[_r-1];
+    if(_ios_tr)
+      for(int k=0; k<_s; ++k)
+	values += _lnunits[_r+k];
+    _node_size = (values * sizeof(T) + alignment - 1) / alignment * alignment / sizeof(T);
+    _size = nnodes * _node_size;
+
+    free(_data); _data = 0;
+    size_t bytes = _size * sizeof(T);
+    if(!bytes) bytes = alignment;
+    void* p = 0;
+    require(!posix_memalign(&p, alignment, bytes), "Cannot allocate activations buffer");
+    _data = static_cast<T*>(p);
+    reset();
+
+    _nrows = _norient * (_r + 1) + (_ios_tr?_s:0);
+    _tables.assign(nnodes * _norient, 0);
+    _rows.assign(nnodes * _nrows, 0);
+  }
+
+  // point the buffers of a node to those of the n-th node of the block
+  void bind(int n, NodeActivations<T>* na) {
+    T* a = _data + n * _node_size;
+    T*** tables = &_tables[n * _norient];
+    T** rows = &_rows[n * _nrows];
+    
+    for(int o=0; o<_norient; ++o) {
+      tables[o] = rows;
+      for(int k=0; k<_r; ++k) {
+	*rows++ = a;
+	a += _lnunits[k];
+      }
+    }
+    na->_layers_activations = tables;
+
+    na->_delta_lr = rows;
+    for(int o=0; o<_norient; ++o) {
+      *rows++ = a;
+      a += _lnunits[_r-1];
+    }
+
+    if(_ios_tr) {
+      na->_h_layers_activations = rows;
+      for(int k=0; k<_s; ++k) {
+	*rows++ = a;
+	a += _lnunits[_r+k];
+      }
+    }
+  }
+
+  bool allocated() const { return _data != 0; }
+  
+  // all activations and deltas of all the nodes at once
+  void reset() { memset(_data, 0, _size * sizeof(T)); }
+};
+
+/*
+  The activations and deltas of the nodes of the instances a network is
+  processing. The nodes of a batch of instances are laid out one after the
+  other, instances in order, in a block which grows to fit the largest
+  batch seen and is then reused, so that the instances only hold inputs,
+  targets and topology and can be shared among networks. Each network,
+  i.e. each parallel worker, has its own workspace.
+
+  The block is not cleared between batches: the forward pass overwrites
+  all the activations, only the deltas at the representation layer are
+  accumulated over the parents of a node. These are cleared when first
+  reached in a batch, which is told by stamping them with the batch
+  generation (see delta).
+*/
+template<typename T>
+class NodeWorkspace {
+  NodeArena<T> _arena;
+  std::vector<NodeActivations<T> > _nodes; // buffers of each node (row) of the batch
+  int _norient, _r, _s;
+  std::vector<int> _lnunits;
+  bool _ios_tr;
+  // first row of each instance of the batch
+  std::unordered_map<const Instance*, int> _offsets;
+  // generation of the current batch, and that of the
+  // batch the deltas of each node and orientation belong to
+  unsigned _generation;
+  std::vector<unsigned> _stamps;
+
+ public:
+ NodeWorkspace(): _norient(0), _r(0), _s(0), _ios_tr(false), _generation(0) {}
+
+  // the buffers of each node, given the number of
+  // orientations and the architecture of the network
+  void layout(int norient, const std::vector<int>& lnunits, int r, int s, bool ios_tr) {
+    _norient = norient; _lnunits = lnunits; _r = r; _s = s; _ios_tr = ios_tr;
+    _nodes.clear();
+    _offsets.clear();
+    _stamps.clear();
+  }
+
+  // make room for the nodes of a batch of instances
+  void assign(Instance* const* first, Instance* const* last) {
+    int nn = 0;
+    _offsets.clear();
+    for(Instance* const* it=first; it!=last; ++it) {
+      _offsets[*it] = nn;
+      nn += (*it)->num_nodes();
+    }
+
+    if(nn > (int)_nodes.size()) {
+      _arena.allocate(nn, _norient, _lnunits, _r, _s, _ios_tr);
+      _nodes.resize(nn);
+      for(int n=0; n<nn; ++n)
+	_arena.bind(n, &_nodes[n]);
+      _stamps.resize(nn*_norient, 0);
+    }
+
+    // all the deltas are stale, restamp them
+    // in the unlikely event of a wrap around
+    if(++_generation == 0) {
+      std::fill(_stamps.begin(), _stamps.end(), 0);
+      _generation = 1;
+    }
+  }
+
+  // the buffers of the nodes of an instance of the batch, by node index
+  NodeActivations<T>* nodes(const Instance* instance) {
+    typename std::unordered_map<const Instance*, int>::const_iterator it = _offsets.find(instance);
+    require(it != _offsets.end(), "Instance has not been propagated through the network");
+    return &_nodes[it->second];
+  }
+
+  // the deltas at the representation layer of a node of the batch in
+  // orientation o, cleared if it is the first time they are reached
+  T* delta(NodeActivations<T>& na, int o) {
+    unsigned& stamp = _stamps[(&na - &_nodes[0])*_norient + o];
+    if(stamp != _generation) {
+      memset(na._delta_lr[o], 0, _lnunits[_r-1] * sizeof(T));
+      stamp = _generation;
+    }
+    return na._delta_lr[o];
+  }
+};
+
+#endif // _NODE_WORKSPACE_H_
@@ -109,6 +109,164 @@ void Options::parse_args(int argc, char* argv[])
       continue;
     }
 
+    pos = line.find("num_threads");
+    if(pos != string::npos) {
+      iss >> dummy >> _num_threads;
+      if(_num_threads <= 0) { throw BadOptionSetting("Must set num_threads to a positive value"); }
+      continue;
+    }
+
+    pos = line.find("parallel_training");
+    if(pos != string::npos) {
+      string training;
+      iss >> dummy >> training;
+      if(training == "SERIAL") { _parallel_training = SERIAL_TRAINING; }
+      else if(training == "SYNCHRONOUS") { _parallel_training = SYNCHRONOUS_TRAINING; }
+      else if(training == "ASYNCHRONOUS") { _parallel_training = ASYNCHRONOUS_TRAINING; }
+      else { throw BadOptionSetting("Unrecognised parallel training"); }
+      continue;
+    }
+
+    pos = line.find("optimizer");
+    if(pos != string::npos) {
+      string optimizer;
+      iss >> dummy >> optimizer;
+      if(optimizer == "GD") { _optimizer = GRADIENT_DESCENT; }
+      else if(optimizer == "MOMENTUM") { _optimizer = MOMENTUM_GRADIENT_DESCENT; }
+      else if(optimizer == "RMSPROP") { _optimizer = RMSPROP; }
+      else if(optimizer == "ADAM") { _optimizer = ADAM; }
+      else if(optimizer == "RPROP") { _optimizer = RPROP; }
+      else if(optimizer == "LBFGS") { _optimizer = LIMITED_MEMORY_BFGS; }
+      else { throw BadOptionSetting("Unrecognised optimizer"); }
+      continue;
+    }
+
+    pos = line.find("beta1");
+    if(pos != string::npos) {
+      iss >> dummy >> _beta1;
+      if(_beta1 < 0 || _beta1 >= 1) { throw BadOptionSetting("Must set beta1 in [0, 1)"); }
+      continue;
+    }
+
+    pos = line.find("beta2");
+    if(pos != string::npos) {
+      iss >> dummy >> _beta2;
+      if(_beta2 < 0 || _beta2 >= 1) { throw BadOptionSetting("Must set beta2 in [0, 1)"); }
+      continue;
+    }
+
+    pos = line.find("epsilon");
+    if(pos != string::npos) {
+      iss >> dummy >> _epsilon;
+      if(_epsilon <= 0) { throw BadOptionSetting("Must set epsilon to a positive value"); }
+      continue;
+    }
+
+    pos = line.find("lbfgs_memory");
+    if(pos != string::npos) {
+      iss >> dummy >> _lbfgs_memory;
+      if(_lbfgs_memory <= 0) { throw BadOptionSetting("Must set lbfgs_memory to a positive value"); }
+      continue;
+    }
+
+    pos = line.find("learning_rate_schedule");
+    if(pos != string::npos) {
+      string schedule;
+      iss >> dummy >> schedule;
+      if(schedule == "CONSTANT") { _learning_rate_schedule = CONSTANT_LR; }
+      else if(schedule == "STEP") { _learning_rate_schedule = STEP_LR; }
+      else if(schedule == "EXPONENTIAL") { _learning_rate_schedule = EXPONENTIAL_LR; }
+      else if(schedule == "COSINE") { _learning_rate_schedule = COSINE_LR; }
+      else if(schedule == "VOGL") { _learning_rate_schedule = VOGL_LR; }
+      else if(schedule == "PLATEAU") { _learning_rate_schedule = PLATEAU_LR; }
+      else { throw BadOptionSetting("Unrecognised learning rate schedule"); }
+      continue;
+    }
+
+    pos = line.find("learning_rate_decay");
+    if(pos != string::npos) {
+      iss >> dummy >> _learning_rate_decay;
+      if(_learning_rate_decay <= 0 || _learning_rate_decay > 1) { throw BadOptionSetting("Must set learning_rate_decay in (0, 1]"); }
+      continue;
+    }
+
+    pos = line.find("learning_rate_min");
+    if(pos != string::npos) {
+      iss >> dummy >> _learning_rate_min;
+      if(_learning_rate_min < 0) { throw BadOptionSetting("Must set learning_rate_min to a non negative value"); }
+      continue;
+    }
+
+    pos = line.find("learning_rate_step");
+    if(pos != string::npos) {
+      iss >> dummy >> _learning_rate_step;
+      if(_learning_rate_step <= 0) { throw BadOptionSetting("Must set learning_rate_step to a positive value"); }
+      continue;
+    }
+
+    pos = line.find("orientations_memory");
+    if(pos != string::npos) {
+      int megabytes;
+      iss >> dummy >> megabytes;
+      if(megabytes < 0) { throw BadOptionSetting("Must set orientations_memory to a non negative value"); }
+      _orientations_memory = megabytes;
+      continue;
+    }
+
+    pos = line.find("weights_layout");
+    if(pos != string::npos) {
+      string layout;
+      iss >> dummy >> layout;
+      if(layout == "INPUT_MAJOR") { _weights_layout = INPUT_MAJOR; }
+      else if(layout == "OUTPUT_MAJOR") { _weights_layout = OUTPUT_MAJOR; }
+      else { throw BadOptionSetting("Unrecognised weights layout"); }
+      continue;
+    }
+
+    pos = line.find("numeric_precision");
+    if(pos != string::npos) {
+      string precision;
+      iss >> dummy >> precision;
+      if(precision == "DOUBLE") { _numeric_precision = DOUBLE_PRECISION; }
+      else if(precision == "SINGLE") { _numeric_precision = SINGLE_PRECISION; }
+      else if(precision == "MIXED") { _numeric_precision = MIXED_PRECISION; }
+      else { throw BadOptionSetting("Unrecognised numeric precision"); }
+      continue;
+    }
+
+    pos = line.find("folding_schedule");
+    if(pos != string::npos) {
+      string schedule;
+      iss >> dummy >> schedule;
+      if(schedule == "NODE") { _folding_schedule = NODE_SCHEDULE; }
+      else if(schedule == "LEVEL") { _folding_schedule = LEVEL_SCHEDULE; }
+      else { throw BadOptionSetting("Unrecognised folding schedule"); }
+      continue;
+    }
+
+    pos = line.find("orientation_schedule");
+    if(pos != string::npos) {
+      string schedule;
+      iss >> dummy >> schedule;
+      if(schedule == "SEQUENTIAL") { _orientation_schedule = SEQUENTIAL_ORIENTATIONS; }
+      else if(schedule == "CONCURRENT") { _orientation_schedule = CONCURRENT_ORIENTATIONS; }
+      else { throw BadOptionSetting("Unrecognised orientation schedule"); }
+      continue;
+    }
+
+    pos = line.find("instruction_set");
+    if(pos != string::npos) {
+      string isa;
+      iss >> dummy >> isa;
+      if(isa == "AUTO") { _instruction_set = AUTO_ISA; }
+      else if(isa == "SCALAR") { _instruction_set = SCALAR_ISA; }
+      else if(isa == "SSE") { _instruction_set = SSE_ISA; }
+      else if(isa == "AVX2") { _instruction_set = AVX2_ISA; }
+      else if(isa == "AVX512") { _instruction_set = AVX512_ISA; }
+      else { throw BadOptionSetting("Unrecognised instruction set"); }
+      continue;
+    }
+
     pos = line.find("domain");
     if(pos != string::npos) {
       string d;
@@ -165,6 +323,11 @@ void Options::parse_args(int argc, char* argv[])
     throw BadOptionSetting("Invalid transduction type: "  + _transduction);
   if(_problem & ~(REGRESSION | BINARYCLASS | MULTICLASS))
     throw BadOptionSetting("Invalid problem type");
+  if(_parallel_training == ASYNCHRONOUS_TRAINING &&
+     _optimizer != GRADIENT_DESCENT && _optimizer != MOMENTUM_GRADIENT_DESCENT)
+    throw BadOptionSetting("Asynchronous training requires the GD or MOMENTUM optimizer");
+  if(_weights_layout == OUTPUT_MAJOR && _folding_schedule != NODE_SCHEDULE)
+    throw BadOptionSetting("The OUTPUT_MAJOR weights layout requires the NODE folding schedule");
 }
 
 void RNNTrainingOptions::parse_args(int argc, char* argv[]) 
@@ -206,12 +369,23 @@ void RNNTrainingOptions::parse_args(int argc, char* argv[])
 	args["validation_set"] = string(argv[++i]);
       } else if(arg == "--threshold-error") {
 	args["threshold_error"] = string(argv[++i]);
+      } else if(arg == "--batch-size") {
+	args["batch_size"] = string(argv[++i]);
+	if(atoi(args["batch_size"].c_str()) <= 0) { throw BadOptionSetting("Must set batch size to a positive value"); }
+      } else if(arg == "--batch-nodes") {
+	args["batch_nodes"] = string(argv[++i]);
+	if(atoi(args["batch_nodes"].c_str()) <= 0) { throw BadOptionSetting("Must set batch nodes to a positive value"); }
+      } else if(arg == "--seed") {
+	args["seed"] = string(argv[++i]);
       } else {
 	cerr << "Unknown switch " << argv[i] << "\n";
 	throw BadOptionSetting(_usage);
       }
     }
   }
+
+  if(args["onlinelearning"] == "1" && (args["batch_size"] != "0" || args["batch_nodes"] != "0"))
+    throw BadOptionSetting("Cannot set mini-batches with on line learning");
 }
 
 Options* Options::instance() throw(BadOptionSetting) {
@@ -33,6 +33,8 @@
  */
 
 #include "StructuredDomain.h"
+#include "ParameterArena.h"
+#include "Kernels.h"
 
 #include <map>
 #include <vector>
@@ -40,6 +42,71 @@
 #include <stdexcept>
 #include <iostream>
 
+/*
+  How a training epoch uses the available threads (num_threads):
+
+  - SERIAL_TRAINING: instances are processed one after the other
+  - SYNCHRONOUS_TRAINING: in batch learning, the instances are split among
+    parallel workers each accumulating the gradient of its share, which are
+    then summed before updating the weights. Results only depend on the
+    number of threads.
+  - ASYNCHRONOUS_TRAINING: in online learning, the instances are split among
+    parallel workers each updating the shared weights after every instance,
+    without locks (Hogwild). Results depend on the interleaving of the updates.
+    Only available with the GRADIENT_DESCENT and MOMENTUM_GRADIENT_DESCENT
+    optimizers, whose rule the workers apply.
+*/
+typedef enum ParallelTraining {
+  SERIAL_TRAINING = 0,
+  SYNCHRONOUS_TRAINING,
+  ASYNCHRONOUS_TRAINING
+} ParallelTraining;
+
+/*
+  Error minimization procedure used to update the weights
+  (see ErrorMinimizationProcedure.h):
+
+  - GRADIENT_DESCENT: plain gradient descent
+  - MOMENTUM_GRADIENT_DESCENT: gradient descent with momentum
+  - RMSPROP: steps scaled by the average squared gradient (beta2)
+  - ADAM: average gradient (beta1) scaled by the average squared gradient (beta2)
+  - RPROP: steps of each weight adapted to the sign changes of its gradient
+  - LIMITED_MEMORY_BFGS: limited memory BFGS (lbfgs_memory updates) with a line search
+                         on the training set error
+
+  RPROP is meant for batch learning, LIMITED_MEMORY_BFGS requires it.
+*/
+typedef enum Optimizer {
+  GRADIENT_DESCENT = 0,
+  MOMENTUM_GRADIENT_DESCENT,
+  RMSPROP,
+  ADAM,
+  RPROP,
+  LIMITED_MEMORY_BFGS
+} Optimizer;
+
+/*
+  How the learning rate changes from one epoch to the next
+  (see LearningRateSchedule.h):
+
+  - CONSTANT_LR: the initial one throughout
+  - STEP_LR: multiplied by learning_rate_decay every learning_rate_step epochs
+  - EXPONENTIAL_LR: multiplied by learning_rate_decay every epoch
+  - COSINE_LR: annealed down to learning_rate_min along half a cosine period
+  - VOGL_LR: Vogl adaptive acceleration, restoring the weights after bad epochs
+           (batch learning only)
+  - PLATEAU_LR: multiplied by learning_rate_decay when the error has not improved
+                for learning_rate_step epochs, down to learning_rate_min
+*/
+typedef enum LRSchedule {
+  CONSTANT_LR = 0,
+  STEP_LR,
+  EXPONENTIAL_LR,
+  COSINE_LR,
+  VOGL_LR,
+  PLATEAU_LR
+} LRSchedule;
+
 /* 
 
   This class manage all application base options that are globally visible
@@ -61,6 +128,24 @@ class Options {
   Domain _domain;
   Transduction _transduction;
   Problem _problem;
+  WeightsLayout _weights_layout;
+  NumericPrecision _numeric_precision;
+  FoldingSchedule _folding_schedule;
+  OrientationSchedule _orientation_schedule;
+  InstructionSet _instruction_set;
+  int _num_threads;
+  ParallelTraining _parallel_training;
+  Optimizer _optimizer;
+  // decay rates of the averages of the gradient and of its square,
+  // and the term added to the root of the latter (RMSprop, Adam)
+  double _beta1, _beta2, _epsilon;
+  // number of updates whose history defines the L-BFGS direction
+  int _lbfgs_memory;
+  LRSchedule _learning_rate_schedule;
+  double _learning_rate_decay, _learning_rate_min;
+  int _learning_rate_step;
+  // memory budget (MB) of the orientations of the instances, 0 for none
+  size_t _orientations_memory;
   
   // a map to store all arguments value in the form of strings.
   // clients have to convert to the appropriate type before using an argument
@@ -76,6 +161,23 @@ class Options {
     _domain = DOAG;
     _transduction = SUPER_SOURCE;
     _problem = UNDEFINED;
+    _weights_layout = INPUT_MAJOR;
+    _numeric_precision = DOUBLE_PRECISION;
+    _folding_schedule = LEVEL_SCHEDULE;
+    _orientation_schedule = SEQUENTIAL_ORIENTATIONS;
+    _instruction_set = AUTO_ISA;
+    _num_threads = 1;
+    _parallel_training = SERIAL_TRAINING;
+    _optimizer = MOMENTUM_GRADIENT_DESCENT;
+    _beta1 = .9;
+    _beta2 = .999;
+    _epsilon = 1e-8;
+    _lbfgs_memory = 10;
+    _learning_rate_schedule = CONSTANT_LR;
+    _learning_rate_decay = .5;
+    _learning_rate_min = 0;
+    _learning_rate_step = 10;
+    _orientations_memory = 0;
     _precision = std::cout.precision();
 
     // the other values must be specified by the user
@@ -128,6 +230,32 @@ class Options {
   Transduction transduction() const { return _transduction; }
   void transduction(Transduction t) { _transduction = t; }
   Problem problem() const { return _problem; }
+  WeightsLayout weights_layout() const { return _weights_layout; }
+  void weights_layout(WeightsLayout l) { _weights_layout = l; }
+  NumericPrecision numeric_precision() const { return _numeric_precision; }
+  void numeric_precision(NumericPrecision p) { _numeric_precision = p; }
+  FoldingSchedule folding_schedule() const { return _folding_schedule; }
+  void folding_schedule(FoldingSchedule s) { _folding_schedule = s; }
+  OrientationSchedule orientation_schedule() const { return _orientation_schedule; }
+  void orientation_schedule(OrientationSchedule s) { _orientation_schedule = s; }
+  InstructionSet instruction_set() const { return _instruction_set; }
+  void instruction_set(InstructionSet i) { _instruction_set = i; }
+  int num_threads() const { return _num_threads; }
+  void num_threads(int n) { _num_threads = n; }
+  ParallelTraining parallel_training() const { return _parallel_training; }
+  void parallel_training(ParallelTraining p) { _parallel_training = p; }
+  Optimizer optimizer() const { return _optimizer; }
+  void optimizer(Optimizer o) { _optimizer = o; }
+  double beta1() const { return _beta1; }
+  double beta2() const { return _beta2; }
+  double epsilon() const { return _epsilon; }
+  int lbfgs_memory() const { return _lbfgs_memory; }
+  size_t orientations_memory() const { return _orientations_memory; }
+  LRSchedule learning_rate_schedule() const { return _learning_rate_schedule; }
+  void learning_rate_schedule(LRSchedule s) { _learning_rate_schedule = s; }
+  double learning_rate_decay() const { return _learning_rate_decay; }
+  double learning_rate_min() const { return _learning_rate_min; }
+  int learning_rate_step() const { return _learning_rate_step; }
 
 };
 
@@ -159,6 +287,9 @@ public:
     args.insert(std::make_pair(std::string("test_set"), std::string("")));
     args.insert(std::make_pair(std::string("validation_set"), std::string("")));
     args.insert(std::make_pair(std::string("threshold_error"), std::string("0.001")));
+    args.insert(std::make_pair(std::string("batch_size"), std::string("0")));
+    args.insert(std::make_pair(std::string("batch_nodes"), std::string("0")));
+    args.insert(std::make_pair(std::string("seed"), std::string("")));
     
     // Usage string: program name is added during command line parsing
     _usage = "[Options]\n"
@@ -175,7 +306,10 @@ public:
       "       --training-set <training set file> [REQUIRED]\n"
       "       --test-set  <test set file> [OPTIONAL]\n"
       "       --validation-set <validation set file> [OPTIONAL]\n"
-      "       --threshold-error <threshold error to be used to stop training> (default is 1e-3)\n";
+      "       --threshold-error <threshold error to be used to stop training> (default is 1e-3)\n"
+      "       --batch-size <number of instances between weight updates> (default is the whole training set)\n"
+      "       --batch-nodes <number of nodes between weight updates> (default is no limit)\n"
+      "       --seed <seed of the shuffling of the instances before each epoch of mini-batches> (default is random)\n";
       
   }											    
   void parse_args(int argc, char* argv[])
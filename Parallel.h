@@ -0,0 +1,143 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+/*
+  Fork-join loops on a set of threads kept from one loop to the next:
+  run(n, nthreads, f) calls f(i) for every i in [0, n) using up to
+  nthreads threads, the calling one included, and returns when all
+  calls are done. Indices are dealt to the threads round-robin, so f
+  must not depend on which thread runs it.
+
+  Threads are created on demand and wait for the next loop between
+  two of them. A pool runs one loop at a time: a loop nested in another
+  one needs a pool of its own. Copies of a pool do not share its threads.
+ */
+class ThreadPool {
+ public:
+  ThreadPool(): _nthreads(0), _pending(0), _generation(0), _stop(false) {}
+  ThreadPool(const ThreadPool&): _nthreads(0), _pending(0), _generation(0), _stop(false) {}
+  ~ThreadPool();
+
+  template<class F>
+    void run(int n, int nthreads, const F& f);
+
+ private:
+  ThreadPool& operator=(const ThreadPool&);
+  void loop(int t, unsigned generation);
+
+  std::vector<std::thread> _threads; // all but the calling one
+  std::mutex _mutex;
+  std::condition_variable _start, _done;
+  // the current loop: body of each thread, threads taking
+  // part in it and still running, how many loops so far
+  std::function<void(int)> _body;
+  int _nthreads, _pending;
+  unsigned _generation;
+  bool _stop;
+};
+
+inline ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _start.notify_all();
+  for(unsigned t=0; t<_threads.size(); ++t)
+    _threads[t].join();
+}
+
+inline void ThreadPool::loop(int t, unsigned generation) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  for(;;) {
+    _start.wait(lock, [&]() { return _stop || _generation != generation; });
+    if(_stop)
+      return;
+    generation = _generation;
+    if(t >= _nthreads)
+      continue;
+
+    lock.unlock();
+    _body(t);
+    lock.lock();
+    if(!--_pending)
+      _done.notify_one();
+  }
+}
+
+template<class F>
+void ThreadPool::run(int n, int nthreads, const F& f) {
+  if(nthreads > n) nthreads = n;
+  if(nthreads <= 1) {
+    for(int i=0; i<n; ++i)
+      f(i);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  while((int)_threads.size() < nthreads-1)
+    _threads.push_back(std::thread(&ThreadPool::loop, this, (int)_threads.size()+1, _generation));
+
+  _body = [&f, n, nthreads](int t) {
+    for(int i=t; i<n; i+=nthreads)
+      f(i);
+  };
+  _nthreads = nthreads;
+  _pending = nthreads-1;
+  ++_generation;
+  lock.unlock();
+  _start.notify_all();
+
+  _body(0);
+
+  lock.lock();
+  _done.wait(lock, [&]() { return !_pending; });
+}
+
+/*
+  Access to values shared among threads which update them without
+  locks (see asynchronous training): each value is read or written
+  as a whole, with no ordering with respect to the other accesses.
+ */
+template<typename T>
+inline T relaxed_load(const T* p) {
+  T v;
+  __atomic_load(p, &v, __ATOMIC_RELAXED);
+  return v;
+}
+
+template<typename T>
+inline void relaxed_store(T* p, T v) {
+  __atomic_store(p, &v, __ATOMIC_RELAXED);
+}
+
+#endif // _PARALLEL_H_
@@ -0,0 +1,219 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#ifndef _PARAMETER_ARENA_H_
+#define _PARAMETER_ARENA_H_
+
+#include "require.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+/*
+
+  Contiguous storage for the parameters of a network.
+
+  All the weight matrices of a network (one for each pair of successive
+  layers of each state transition and output MLP) are laid out one after
+  the other in a single aligned buffer. The same layout is shared by all
+  the buffers that play a different role for the same set of connections
+  (current weights, previous weights, gradient components, momentum terms...),
+  so that the element at a given position in any of them always refers to
+  the same connection. Whole-model operations (reset, restore, norm, update)
+  can then be performed as single linear sweeps over the buffers.
+
+*/
+
+/*
+  Storage orientation of the connection weights of a layer:
+
+  - INPUT_MAJOR: one row per unit in the lower layer, i.e. the outgoing
+    weights of an input unit are contiguous (the layout of the parameters
+    buffers, the default)
+  - OUTPUT_MAJOR: one row per unit in the upper layer, i.e. the incoming
+    weights of an output unit are contiguous (a copy of the folding weights
+    kept in sync by the network, with the NODE folding schedule only).
+    The forward pass then sums the terms of each unit in another order:
+    outputs may differ from INPUT_MAJOR in the last bits.
+*/
+typedef enum WeightsLayout {
+  INPUT_MAJOR = 0,
+  OUTPUT_MAJOR
+} WeightsLayout;
+
+/*
+  Floating point precision of the network:
+
+  - DOUBLE_PRECISION: weights, activations and gradients are doubles
+  - SINGLE_PRECISION: weights, activations and gradients are floats
+  - MIXED_PRECISION: weights and activations are floats, gradient
+    components are accumulated in double precision
+*/
+typedef enum NumericPrecision {
+  DOUBLE_PRECISION = 0,
+  SINGLE_PRECISION,
+  MIXED_PRECISION
+} NumericPrecision;
+
+/*
+  A view over a dense matrix of connections between two successive layers:
+  rows index the units in the lower layer (the threshold unit is the last row),
+  columns index the units in the upper layer. Rows are padded so that each of
+  them begins on an aligned boundary, padding entries are kept to zero.
+*/
+template<typename T>
+class Matrix {
+  T* _data;
+  int _rows, _cols, _stride;
+
+ public:
+ Matrix(): _data(0), _rows(0), _cols(0), _stride(0) {}
+ Matrix(T* data, int rows, int cols, int stride):
+  _data(data), _rows(rows), _cols(cols), _stride(stride) {}
+
+  T* operator[](int i) { return _data + i*_stride; }
+  const T* operator[](int i) const { return _data + i*_stride; }
+
+  T* data() { return _data; }
+  int rows() const { return _rows; }
+  int cols() const { return _cols; }
+  int stride() const { return _stride; }
+  size_t size() const { return (size_t)_rows * _stride; }
+};
+
+/*
+  Describes the sequence of matrices making up the parameters of a network.
+  Offsets and strides are expressed in number of elements, independently
+  of the type actually stored, so buffers of different scalar types built
+  on the same layout remain position-wise aligned.
+*/
+class ParameterLayout {
+ public:
+  enum {
+    row_alignment = 8, // row padding, in number of elements
+    alignment = 64     // buffer alignment, in bytes
+  };
+
+ private:
+  struct Block {
+    int rows, cols, stride;
+    size_t offset;
+  };
+  std::vector<Block> _blocks;
+  size_t _size;
+
+ public:
+ ParameterLayout(): _size(0) {}
+
+  // append a matrix with the given dimensions, return its index
+  int add(int rows, int cols) {
+    Block b;
+    b.rows = rows;
+    b.cols = cols;
+    b.stride = ((cols + row_alignment - 1) / row_alignment) * row_alignment;
+    b.offset = _size;
+    _blocks.push_back(b);
+    _size += (size_t)b.rows * b.stride;
+
+    return _blocks.size() - 1;
+  }
+
+  void clear() { _blocks.clear(); _size = 0; }
+
+  int num_blocks() const { return _blocks.size(); }
+  size_t size() const { return _size; }
+  int rows(int b) const { return _blocks[b].rows; }
+  int cols(int b) const { return _blocks[b].cols; }
+  int stride(int b) const { return _blocks[b].stride; }
+  size_t offset(int b) const { return _blocks[b].offset; }
+};
+
+/*
+  A buffer of parameters of a given type organised according to a layout.
+*/
+template<typename T>
+class ParameterArena {
+  ParameterLayout _layout;
+  T* _data;
+
+  // prevent assignment and copy construction
+  ParameterArena(const ParameterArena&);
+  ParameterArena& operator=(const ParameterArena&);
+
+ public:
+ ParameterArena(): _data(0) {}
+  ~ParameterArena() { free(_data); }
+
+  // (re)allocate a zeroed buffer to host parameters with the given layout
+  void allocate(const ParameterLayout& layout) {
+    free(_data); _data = 0;
+    _layout = layout;
+
+    size_t bytes = _layout.size() * sizeof(T);
+    if(!bytes) bytes = ParameterLayout::alignment;
+    void* p = 0;
+    require(!posix_memalign(&p, ParameterLayout::alignment, bytes), "Cannot allocate parameters buffer");
+    _data = static_cast<T*>(p);
+    reset();
+  }
+
+  // free the buffer
+  void release() { free(_data); _data = 0; }
+
+  bool allocated() const { return _data != 0; }
+  
+  const ParameterLayout& layout() const { return _layout; }
+  
+  // the whole model as a single span
+  T* data() { return _data; }
+  const T* data() const { return _data; }
+  size_t size() const { return _layout.size(); }
+
+  // the view of a single matrix
+  Matrix<T> block(int b) {
+    return Matrix<T>(_data + _layout.offset(b), _layout.rows(b), _layout.cols(b), _layout.stride(b));
+  }
+
+  void reset() { memset(_data, 0, _layout.size() * sizeof(T)); }
+
+  // exchange the buffers of two arenas with the same layout, views
+  // over either buffer must be rebound by the client
+  void swap(ParameterArena& other) {
+    require(other.size() == size(), "Mismatch in parameters layout");
+    std::swap(_data, other._data);
+  }
+
+  // copy the values of another buffer with the same layout
+  template<typename S>
+    void assign(const ParameterArena<S>& other) {
+    require(other.size() == size(), "Mismatch in parameters layout");
+    const S* src = other.data();
+    for(size_t p=0; p<size(); ++p)
+      _data[p] = src[p];
+  }
+};
+
+#endif // _PARAMETER_ARENA_H_
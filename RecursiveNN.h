@@ -27,15 +27,21 @@
 
 #include "require.h"
 #include "Options.h"
+#include "ParameterArena.h"
+#include "Kernels.h"
+#include "Parallel.h"
 #include "ActivationFunctions.h"
 #include "ErrorMinimizationProcedure.h"
 #include "DataSet.h"
 #include "Model.h"
+#include "NodeWorkspace.h"
 
 #include <ctime>
 #include <cfloat>
 
 #include <vector>
+#include <algorithm>
+#include <type_traits>
 #include <fstream>
 #include <iostream>
 
@@ -43,12 +49,12 @@ using std::cout;
 using std::endl;
 
 // Generate a random number between 0.0 and 1.0
-double rnd01() {
+inline double rnd01() {
   return ((double) rand() / (double) RAND_MAX);
 }
 
 // Generate a random number between -1.0 and +1.0
-double nrnd01() {
+inline double nrnd01() {
   return ((rnd01() * 2.0) - 1.0);
 }
 
@@ -62,9 +68,13 @@ double nrnd01() {
   Another natural change would be to implement different
   error minimization procedures (adding momentum to gradient descent,
   conjugate gradient) via the Strategy Pattern.
+
+  T is the floating point type of weights, activations and deltas,
+  G the type in which gradient components are accumulated.
 */
 
-template<class HA_Function, class OA_Function, class EMP>
+template<class HA_Function, class OA_Function,
+  template<typename, typename> class EMP, typename T = double, typename G = T>
   class RecursiveNN: public Model {
   
   bool _ss_tr; // implement a super-source transduction
@@ -90,24 +100,153 @@ template<class HA_Function, class OA_Function, class EMP>
   */
   std::vector<int> _lnunits;
   
+  /*
+    Network parameters: connection weights and their gradient components
+    are each stored in a single contiguous buffer, both sharing the same
+    layout (see ParameterArena.h).
+    Weights have type T, gradient components are accumulated with type G
+    (e.g. float weights with double gradients).
+   */
+  ParameterLayout _layout;
+  ParameterArena<T> _w;
+  ParameterArena<G> _gradient_w;
+
+  /*
+    When rollback is enabled, the weight update rule writes the new
+    weights in a shadow buffer which is then swapped with the current
+    one, so that the shadow keeps the weights before the last update
+    and restoring them is again a swap. Nothing is allocated or copied
+    when rollback is disabled.
+   */
+  ParameterArena<T> _shadow_w;
+  bool _rollback; // whether rollback is enabled
+  bool _can_rollback; // whether the shadow holds the weights before the last update
+  // where the error is evaluated by procedures searching along a direction
+  DataSet* _line_search_set;
+
   /*
     Represent connection weights between successive layers
     for each neural network (MLP) implementing a state transition
-    function along an orientation of the data structure
+    function along an orientation of the data structure.
+    These are views, indexed by orientation and layer, over the
+    parameters buffers.
    */
-  double**** _layers_w;
-  double**** _prev_layers_w; // weight values in previous learning step
-  // error signals (delta) for each unit/layer/orientation
-  // (exclude representation layer, stored in node) 
-  double***  _delta_layers;
+  std::vector<std::vector<Matrix<T> > > _layers_w;
   // the contribution to the gradient of each connection weight
   // between successive layers in each MLP
-  double**** _layers_gradient_w; 
+  std::vector<std::vector<Matrix<G> > > _layers_gradient_w; 
+  /*
+    Folding weights can also be kept in output unit major order, i.e.
+    with the incoming weights of each unit stored contiguously, which
+    is the access pattern of forward propagation. Backward propagation
+    keeps using the (input unit major) views above. Only the node
+    schedule reads this copy: the other ones do not keep it.
+  */
+  static WeightsLayout weightsLayout() {
+    return Options::instance()->folding_schedule() == NODE_SCHEDULE?
+      Options::instance()->weights_layout():INPUT_MAJOR;
+  }
+  WeightsLayout _weights_layout;
+  ParameterArena<T> _wt;
+  std::vector<std::vector<Matrix<T> > > _layers_wt;
+  // error signals (delta) for each unit/layer/orientation
+  // (exclude representation layer, stored in node) 
+  T***  _delta_layers;
+
+  // How the nodes of an orientation go through the folding part
+  FoldingSchedule _schedule;
+  // Whether sequences (SEQUENCE and LINEARCHAIN domains) are scheduled
+  // by the dedicated engine, instead of going through their graphs
+  bool _packed;
+  // Whether the levels are the anti-diagonal wavefronts of a grid (GRID2D
+  // domain), which can keep several threads busy
+  bool _grid;
+  // Whether the levels and the children of the nodes are computed from the
+  // indices of the nodes (sequences and grids, see Instance::implicit),
+  // instead of being read from the orientations
+  bool _implicit;
+  // Threads working on the folding part: with the level schedule, the rows
+  // of a level are split among them
+  int _nthreads;
+  // Orientations have their own weights, deltas and node activations:
+  // they can go through their folding parts on separate threads
+  OrientationSchedule _orientation_schedule;
+  // Threads running the orientations and the workers, kept from one
+  // loop to the next (those sharing the rows of the levels of an
+  // orientation are in its workspace)
+  ThreadPool _pool;
+
+  /*
+    Synchronous data-parallel training: the instances are split among
+    workers, networks with the same architecture whose weight views are
+    bound to the weights of this one. Each accumulates the gradient of its
+    share in its own buffer, the buffers are then summed into the gradient
+    of this network in a fixed order.
+   */
+  ParallelTraining _parallel_training;
+  std::vector<RecursiveNN*> _workers;
+  /*
+    Asynchronous (Hogwild) online training: workers update the weights of
+    the network themselves, each with its own momentum (the previous
+    weight deltas, as in MGradientDescent)
+   */
+  ParameterArena<G> _momentum_w;
+
+  /*
+    Sequences engine: the sequences to process sorted by decreasing length,
+    so that the sequences still active at a time step are a prefix of those
+    at the previous step, whose rows hold the representations of their
+    children.
+   */
+  struct PackedSequence {
+    Instance* instance;
+    int length;
+    int offset; // first row of the sequence in the label projections
+    NodeActivations<T>* nodes; // buffers of its elements
+
+    bool operator<(const PackedSequence& s) const { return length > s.length; }
+  };
+  std::vector<PackedSequence> _sequences;
+
+  /*
+    Node input labels of the instances being propagated, one row
+    for each node.
+   */
+  std::vector<T> _labels;
 
-  typedef double*** Node::*PTNLA;
-  typedef double**  Node::*PTNDV;
-  PTNLA ptn_la;
-  PTNDV ptn_dv;
+  /*
+    Blocks used to process the nodes of an orientation which do not
+    depend on each other (a level, a time step) at once, one row per node:
+    inputs of the first layer (node label and representations of the
+    children by position), activations and deltas of each layer, errors
+    to redistribute to the children. They grow on demand.
+    Each orientation has its own, so that they can be processed concurrently.
+   */
+  struct FoldingWorkspace {
+    std::vector<T> inputs, errors;
+    std::vector<std::vector<T> > activations, deltas;
+    // the orientation of each instance being processed, held until the
+    // next batch so that it is not dropped while in use (DPAGs only)
+    std::vector<Instance::OrientationRef> orientations;
+    // instance and index of each node (row) in the current level
+    std::vector<std::pair<Instance*, int> > nodes;
+    // buffers and graph (DPAGs only) of the instance of each node of the level
+    std::vector<NodeActivations<T>*> buffers;
+    std::vector<const CSRGraph*> graphs;
+    // row of each node of the level in the label projections
+    std::vector<int> rows;
+    // representations of the children at the next time step (sequences engine)
+    std::vector<T> states;
+    // projection of the labels onto the first layer of the folding part,
+    // i.e. the contribution of the labels to the net input of its units
+    std::vector<T> projections;
+    // threads sharing the rows of the levels of the orientation
+    ThreadPool pool;
+  };
+  std::vector<FoldingWorkspace> _workspaces;
+
+  // The activations and deltas of the nodes being processed
+  NodeWorkspace<T> _activations;
   
   /*
     Super-source transduction 
@@ -115,20 +254,24 @@ template<class HA_Function, class OA_Function, class EMP>
 
     The output function is again a MLP
    */
-  double*** _g_layers_w;
-  double*** _prev_g_layers_w;
-  double**  _g_layers_activations;
-  double**  _delta_g_layers;
-  double*** _g_layers_gradient_w;
+  std::vector<Matrix<T> > _g_layers_w;
+  // output activations and error signals in g MLP layers,
+  // one row for each instance propagated at once
+  std::vector<std::vector<T> > _g_layers_activations, _delta_g_layers;
+  // representations of the super-source nodes (g MLP inputs)
+  // and errors to redistribute to them, one row for each instance
+  std::vector<T> _g_inputs, _g_errors;
+  std::vector<Matrix<G> > _g_layers_gradient_w;
   
   /*
     IO-Isomorph transduction: an output is associate to each node of a given instance
     Represents connection weights in the network implementing the node output function
    */
-  double*** _h_layers_w;
-  double*** _prev_h_layers_w;
-  double**  _delta_h_layers; // error signals in h output map layers
-  double*** _h_layers_gradient_w;
+  std::vector<Matrix<T> > _h_layers_w;
+  T**  _delta_h_layers; // error signals in h output map layers
+  // inputs of the h MLP: node representations and label
+  std::vector<T> _h_inputs;
+  std::vector<Matrix<G> > _h_layers_gradient_w;
  
   // Template parameters indicate the type of hidden and output units
   // activation function.
@@ -140,42 +283,85 @@ template<class HA_Function, class OA_Function, class EMP>
      The Net mantains an object that implements one 
      of the possibile error minimization procedures.
   */
-  friend EMP; // EMP object must be able to easily update net weights
-  EMP _wu_method;
+  friend class EMP<T, G>; // EMP object must be able to easily update net weights
+  EMP<T, G> _wu_method;
 
   /* Private functions */
 
+  // The buffer where the update rule writes the new weights
+  T* updatedWeights() { return _rollback?_shadow_w.data():_w.data(); }
+
+  // A worker of the given network (see _workers)
+  explicit RecursiveNN(const RecursiveNN*);
+  // Bind the weights views of a worker to the current weights of its network
+  void shareWeights(const RecursiveNN*);
+  void reduceGradients(int);
+  void updateSharedWeights(RecursiveNN*, float, float, float);
+  RecursiveNN* worker(int);
+
+  // Allocate parameters buffers and bind the views over them
+  void allocParameters(bool = true);
+  void bindParameters();
+  void bindWeights();
+  void initParameters();
+  void transposeFoldingWeights();
+
   // Specialized allocation&deallocation functions
-  void allocFoldingParts(double****, double****, double****, double***);
+  void allocFoldingParts(T***);
   void allocSSPart();
   void allocIOSPart();
 
-  void deallocFoldingParts(double****, double****, double****, double***);
-  void deallocSSPart();
+  void deallocFoldingParts(T***);
   void deallocIOSPart();
 
-  // Reset gradient components every time weights are updated.
-  void resetFoldingGradient(double****);
-  void resetSSGradient();
-  void resetIOSGradient();
-
-  // Reset output values in g MLP layers
-  void resetSSValues();
+  // Propagation and back-propagation of a contiguous
+  // range of instances, possibly just one
+  void propagateInstances(Instance* const*, Instance* const*);
+  void backPropagateInstances(Instance* const*, Instance* const*);
+  // Whether the orientations run concurrently: on request, and always
+  // for grids when there are threads to share among their wavefronts
+  bool concurrentOrientations() const {
+    return _orientation_schedule == CONCURRENT_ORIENTATIONS ||
+      (_grid && _schedule == LEVEL_SCHEDULE && _nthreads > 1);
+  }
   
   // Propagation routines for
   // each specific part of the Net.
-  void propagateInputOnFoldingPart(Instance*, int);
-  void gPropagateInput(Instance*);
-  void hPropagateInput(Node*);
+  void gatherLabels(Instance* const*, Instance* const*);
+  void projectLabels(int);
+  void propagateInputOnFoldingPart(Instance*, int, const T*);
+  void propagateLevelsOnFoldingPart(Instance* const*, Instance* const*, int, int);
+  void packSequences(Instance* const*, Instance* const*);
+  void propagateSequencesOnFoldingPart(int);
+  // Element of a sequence processed at a given time step in an orientation:
+  // the first is a leaf, the child of the others is the one at the previous step
+  int sequenceNode(const PackedSequence& seq, int o, int s) const { return o?seq.length-1-s:s; }
+  void holdOrientations(Instance* const*, Instance* const*, int);
+  uint numLevels(Instance* const*, Instance* const*, int);
+  int gatherLevelNodes(Instance* const*, Instance* const*, int, uint);
+  void gatherNodeInputs(Instance*, const CSRGraph*, NodeActivations<T>*, int, int, T*);
+  // Blocks of rows a level of nb nodes is split into for nthreads threads,
+  // so that no thread gets too few rows to be worth starting it
+  int numChunks(int nb, int nthreads) const { return std::max(1, std::min(nthreads, nb/16)); }
+  void propagateLevelRows(int, int, int);
+  void gatherOutputInputs(Node*, const NodeActivations<T>&);
+  void gatherSuperSources(Instance* const*, Instance* const*);
+  void gPropagateInput(Instance* const*, Instance* const*);
+  void hPropagateInput(Node*, NodeActivations<T>&);
 
   // Error Back-Propagation Through Structures 
   // routines for each specific part of the Net.
   void backPropOnFoldingPart(Instance*, int);
-  void gBackPropagateError(Instance*);
-  void hBackPropagateError(Node*);
+  void backPropLevelsOnFoldingPart(Instance* const*, Instance* const*, int, int);
+  void backPropLevelRows(int, int, int);
+  void levelGradientRows(int, int, int, int);
+  void backPropSequencesOnFoldingPart(int);
+  void gBackPropagateError(Instance* const*, Instance* const*);
+  void hBackPropagateError(Node*, NodeActivations<T>&);
 
   double computeSSError(Instance*);
   double computeIOSError(Instance*);
+  double sumErrors(DataSet*, double (RecursiveNN::*)(Instance*));
   
  public:
   /*
@@ -193,11 +379,25 @@ template<class HA_Function, class OA_Function, class EMP>
   void propagateStructuredInput(Instance*);
   void backPropagateError(Instance*);
 
+  // Same, for a batch of instances at once: the nodes with the same height
+  // in all the instances, and their super-source nodes, are processed
+  // together by the same matrix products
+  void propagateStructuredInput(DataSet::const_iterator, DataSet::const_iterator);
+  void backPropagateError(DataSet::const_iterator, DataSet::const_iterator);
+  void accumulateGradient(DataSet::const_iterator, DataSet::const_iterator);
+  void trainOnline(DataSet::const_iterator, DataSet::const_iterator,
+		   float = 0.0, float = 0.0, float = 0.0);
+
   // Implements weight update rule
   void adjustWeights(float = 0.0, float = 0.0, float = 0.0);
-  // To restore previous parameters settings, so
-  // we can adjust learning rate, in case we make a bad move
-  void restorePrevWeights();
+
+  // Keep the weights before each update, so that we can restore
+  // them and adjust learning rate in case we make a bad move
+  void enableRollback(bool = true);
+  // Restore the weights before the last update
+  void rollback();
+  // Instances on which line searches evaluate the error
+  void lineSearchSet(DataSet* dataset) { _line_search_set = dataset; }
 
   // To reset gradient components, made public so training procedure
   // can use it to begin another training phase using the same network.
@@ -218,6 +418,12 @@ template<class HA_Function, class OA_Function, class EMP>
   double computeError(Instance*);
   double computeError(DataSet*);
 
+  // The error whose gradient backpropagation computes: halved sum
+  // of squares not averaged over nodes or instances in regression,
+  // cross-entropy in classification (the loss of the line searches)
+  double computeLoss(Instance*);
+  double computeLoss(DataSet*);
+
   // Compute the (squared norm) of the weights, necessary in order
   // to compute the error when regularization is used (weight decay).
   double computeWeightsNorm();
@@ -230,471 +436,226 @@ template<class HA_Function, class OA_Function, class EMP>
 *********************************************************/
 
 
-/* Private: F folding part allocation routine */
+/* Private: parameters allocation routine */
 
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::allocFoldingParts(double**** layers_w, double**** prev_layers_w, double**** layers_gradient_w, double*** delta_layers) {
-  // Assume constructor has initialized required dimension quantities
-  *layers_w = new double**[_r];
-  *prev_layers_w = new double**[_r];
-  *layers_gradient_w = new double**[_r];
-  if(_r > 1) {
-    *delta_layers = new double*[_r-1];
-    (*delta_layers)[0] = new double[_lnunits[0]];
-    memset((*delta_layers)[0], 0, (_lnunits[0]) * sizeof(double));
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::allocParameters(bool weights) {
+  // Assume constructor has initialized required dimension quantities.
+  // Describe the weight matrices of the network in the order they are laid
+  // out in memory: the layers of the folding part of each orientation first,
+  // then the layers of the g (super-source) or h (io-isomorph) output function.
+  // Each matrix automatically includes space for threshold unit in the lower layer.
+  _layout.clear();
+
+  // Connections from input layer of the folding parts have special dimensions.
+  for(int o=0; o<_norient; ++o) {
+    _layout.add((_n+_v*_m) + 1, _lnunits[0]);
+    for(int k=1; k<_r; k++)
+      _layout.add(_lnunits[k-1] + 1, _lnunits[k]);
   }
 
-  // Allocate weights and gradient components matrixes
-  // for f folding part. Connections from input layer
-  // have special dimensions.
-  (*layers_w)[0] = new double*[(_n+_v*_m) + 1];
-  (*prev_layers_w)[0] = new double*[(_n+_v*_m) + 1];
-  (*layers_gradient_w)[0] = new double*[(_n+_v*_m) + 1];
+  if(_ss_tr) {
+    _layout.add(_norient*_m + 1, _lnunits[_r]);
+    for(int k=1; k<_s; k++)
+      _layout.add(_lnunits[_r+k-1] + 1, _lnunits[_r+k]);
+  }
 
-  for(int i=0; i<(_n+_v*_m) + 1; i++) {
-    (*layers_w)[0][i] = new double[_lnunits[0]];
-    (*prev_layers_w)[0][i] = new double[_lnunits[0]];
-    (*layers_gradient_w)[0][i] = new double[_lnunits[0]];
+  if(_ios_tr) {
+    _layout.add(_norient*_m + _n + 1, _lnunits[_r]);
+    for(int k=1; k<_s; k++)
+      _layout.add(_lnunits[_r+k-1] + 1, _lnunits[_r+k]);
+  }
 
-    // Reset gradient for corresponding weights
-    memset((*layers_gradient_w)[0][i], 0, _lnunits[0] * sizeof(double));
-	
-    // Assign weights a random number between -1.0 and +1.0
-    for(int j=0; j<_lnunits[0]; j++) {
-      (*layers_w)[0][i][j] = nrnd01() / static_cast<double>(_lnunits[0]);
-      (*prev_layers_w)[0][i][j] = (*layers_w)[0][i][j];
-    }
+  // Allocate weights (unless those of another network are used)
+  // and gradient components (all buffers are reset on allocation)
+  if(weights)
+    _w.allocate(_layout);
+  _gradient_w.allocate(_layout);
+
+  // Allocate output unit major copy of the folding weights
+  if(weights && _weights_layout == OUTPUT_MAJOR) {
+    ParameterLayout layout;
+    for(int o=0; o<_norient; ++o)
+      for(int k=0; k<_r; k++)
+	layout.add(_layout.cols(o*_r+k), _layout.rows(o*_r+k));
+    _wt.allocate(layout);
   }
   
-  // Allocate f weights&gradient matrixes for f folding part.
-  for(int k=1; k<_r; k++) {
-    // Allocate space for weight&delta matrix between layer i-1 and i.
-    // Automatically include space for threshold unit in layer i-1
-    (*layers_w)[k] = new double*[_lnunits[k-1] + 1];
-    (*prev_layers_w)[k] = new double*[_lnunits[k-1] + 1];
-    (*layers_gradient_w)[k] = new double*[_lnunits[k-1] + 1];
-
-    for(int i=0; i<_lnunits[k-1]+1; i++) {
-      (*layers_w)[k][i] = new double[_lnunits[k]];
-      (*prev_layers_w)[k][i] = new double[_lnunits[k]];
-      (*layers_gradient_w)[k][i] = new double[_lnunits[k]];
-
-      // Reset f gradient components for corresponding weights
-      memset((*layers_gradient_w)[k][i], 0, (_lnunits[k])*sizeof(double));
-
-      // Assign f weights a random number between -1.0 and +1.0
-      for(int j=0; j<_lnunits[k]; j++) {
-	(*layers_w)[k][i][j] = nrnd01() / static_cast<double>(_lnunits[k]);
-	(*prev_layers_w)[k][i][j] = (*layers_w)[k][i][j];
-      }
-    }
-   
-    if(k < _r-1) {
-      (*delta_layers)[k] = new double[_lnunits[k]];
-      memset((*delta_layers)[k], 0, (_lnunits[k]) * sizeof(double));
-    }
-  }  
+  bindParameters();
 }
 
-/* Private: SS tranforming part allocation routine */
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::allocSSPart() {
-  // Assume constructor has initialized required dimension quantities
-  _g_layers_w = new double**[_s];
-  _prev_g_layers_w = new double**[_s];
-  _g_layers_gradient_w = new double**[_s];
-  _g_layers_activations = new double*[_s];
-  _delta_g_layers = new double*[_s];
-
-  // Allocate weights and gradient components matrixes
-  // for g transforming part. Connections from input layers
-  // have special dimensions.
-  _g_layers_w[0] = new double*[_norient*_m + 1];
-  _prev_g_layers_w[0] = new double*[_norient*_m + 1];
-  _g_layers_gradient_w[0] = new double*[_norient*_m + 1];
-  
-  // Allocate and reset g layers output activation units and delta values.
-  _g_layers_activations[0] = new double[_lnunits[_r]];
-  memset(_g_layers_activations[0], 0, (_lnunits[_r])*sizeof(double));
-  _delta_g_layers[0] = new double[_lnunits[_r]];
-  memset(_delta_g_layers[0], 0, (_lnunits[_r])*sizeof(double));
-
+/* Private: bind per-orientation/per-layer matrix views to the parameters buffers */
 
-  for(int i=0; i<_norient*_m + 1; i++) {
-    _g_layers_w[0][i] = new double[_lnunits[_r]];
-    _prev_g_layers_w[0][i] = new double[_lnunits[_r]];
-    _g_layers_gradient_w[0][i] = new double[_lnunits[_r]];
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::bindParameters() {
+  int b = 0;
+  
+  _layers_w.assign(_norient, std::vector<Matrix<T> >(_r));
+  _layers_gradient_w.assign(_norient, std::vector<Matrix<G> >(_r));
+  for(int o=0; o<_norient; ++o)
+    for(int k=0; k<_r; k++, b++)
+      _layers_gradient_w[o][k] = _gradient_w.block(b);
+
+  if(_wt.allocated()) {
+    _layers_wt.assign(_norient, std::vector<Matrix<T> >(_r));
+    for(int o=0; o<_norient; ++o)
+      for(int k=0; k<_r; k++)
+	_layers_wt[o][k] = _wt.block(o*_r+k);
+  }
 
-    // Reset gradient for corresponding weights
-    memset(_g_layers_gradient_w[0][i], 0, _lnunits[_r] * sizeof(double));
-	
-    // Assign weights a random number between -1.0 and +1.0
-    for(int j=0; j<_lnunits[_r]; j++) {
-      _g_layers_w[0][i][j] = nrnd01() / static_cast<double>(_lnunits[_r]);
-      _prev_g_layers_w[0][i][j] = _g_layers_w[0][i][j];
-    }
+  if(_ss_tr) {
+    _g_layers_w.resize(_s);
+    _g_layers_gradient_w.resize(_s);
+    for(int k=0; k<_s; k++, b++)
+      _g_layers_gradient_w[k] = _gradient_w.block(b);
   }
-  
-  // Allocate weights&gradient matrixes for g transforming part
-  for(int k=1; k<_s; k++) {
-    // Allocate space for weight&gradient matrixes between layer i-1 and i.
-    // Automatically include space for threshold unit in layer i-1
-    _g_layers_w[k] = new double*[_lnunits[_r+k-1] + 1];
-    _prev_g_layers_w[k] = new double*[_lnunits[_r+k-1] + 1];
-    _g_layers_gradient_w[k] = new double*[_lnunits[_r+k-1] + 1];
-
-    // Allocate and reset g layers output activation units and delta layers values.
-    _g_layers_activations[k] = new double[_lnunits[_r+k]];
-    memset(_g_layers_activations[k], 0, (_lnunits[_r+k])*sizeof(double));
-
-    _delta_g_layers[k] = new double[_lnunits[_r+k]];
-    memset(_delta_g_layers[k], 0, (_lnunits[_r+k])*sizeof(double));
-
-    for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-      _g_layers_w[k][i] = new double[_lnunits[_r+k]];
-      _prev_g_layers_w[k][i] = new double[_lnunits[_r+k]];
-      _g_layers_gradient_w[k][i] = new double[_lnunits[_r+k]];
-
-      // Reset g gradient components for corresponding weights
-      memset(_g_layers_gradient_w[k][i], 0, (_lnunits[_r+k])*sizeof(double));
-
-      // Assign g weights a random number between -1.0 and +1.0
-      for(int j=0; j<_lnunits[_r+k]; j++) {
-	_g_layers_w[k][i][j] = nrnd01() / static_cast<double>(_lnunits[_r+k]);
-	_prev_g_layers_w[k][i][j] = _g_layers_w[k][i][j];
-      }
-    } 
+
+  if(_ios_tr) {
+    _h_layers_w.resize(_s);
+    _h_layers_gradient_w.resize(_s);
+    for(int k=0; k<_s; k++, b++)
+      _h_layers_gradient_w[k] = _gradient_w.block(b);
   }
+
+  if(_w.allocated())
+    bindWeights();
 }
 
-/* Private: IOS tranforming part allocation routine */
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::allocIOSPart() {
-  // Assume constructor has initialized required dimension quantities
-  _h_layers_w = new double**[_s];
-  _prev_h_layers_w = new double**[_s];
-  _h_layers_gradient_w = new double**[_s];
-  _delta_h_layers = new double*[_s];
-
-  // Allocate weights and gradient components matrixes
-  // for h transforming part. Connections from input layers
-  // have special dimensions.
-  _h_layers_w[0] = new double*[_norient*_m + _n + 1];
-  _prev_h_layers_w[0] = new double*[_norient*_m + _n + 1];
-  _h_layers_gradient_w[0] = new double*[_norient*_m + _n + 1];
+/* Private: bind the weights views to the current weights buffer */
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::bindWeights() {
+  int b = 0;
   
-  // Allocate and reset h first layer delta values.
-  _delta_h_layers[0] = new double[_lnunits[_r]];
-  memset(_delta_h_layers[0], 0, (_lnunits[_r])*sizeof(double));
+  for(int o=0; o<_norient; ++o)
+    for(int k=0; k<_r; k++, b++)
+      _layers_w[o][k] = _w.block(b);
 
-  for(int i=0; i<_norient*_m + _n + 1; i++) {
-    _h_layers_w[0][i] = new double[_lnunits[_r]];
-    _prev_h_layers_w[0][i] = new double[_lnunits[_r]];
-    _h_layers_gradient_w[0][i] = new double[_lnunits[_r]];
+  if(_ss_tr)
+    for(int k=0; k<_s; k++, b++)
+      _g_layers_w[k] = _w.block(b);
 
-    // Reset gradient for corresponding weights
-    memset(_h_layers_gradient_w[0][i], 0, _lnunits[_r] * sizeof(double));
-	
-    // Assign weights a random number between -1.0 and +1.0
-    for(int j=0; j<_lnunits[_r]; j++) {
-      _h_layers_w[0][i][j] = nrnd01() / static_cast<double>(_lnunits[_r]);
-      _prev_h_layers_w[0][i][j] = _h_layers_w[0][i][j];
-    }
-  }
-  
-  // Allocate weights&gradient matrixes for h map
-  for(int k=1; k<_s; k++) {
-    // Allocate space for weight&gradient matrixes between layer i-1 and i.
-    // Automatically include space for threshold unit in layer i-1
-    _h_layers_w[k] = new double*[_lnunits[_r+k-1] + 1];
-    _prev_h_layers_w[k] = new double*[_lnunits[_r+k-1] + 1];
-    _h_layers_gradient_w[k] = new double*[_lnunits[_r+k-1] + 1];
-
-    // Allocate and reset h layers delta layers values.
-    _delta_h_layers[k] = new double[_lnunits[_r+k]];
-    memset(_delta_h_layers[k], 0, (_lnunits[_r+k])*sizeof(double));
-
-    for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-      _h_layers_w[k][i] = new double[_lnunits[_r+k]];
-      _prev_h_layers_w[k][i] = new double[_lnunits[_r+k]];
-      _h_layers_gradient_w[k][i] = new double[_lnunits[_r+k]];
-
-      // Reset h gradient components for corresponding weights
-      memset(_h_layers_gradient_w[k][i], 0, (_lnunits[_r+k])*sizeof(double));
-
-      // Assign h weights a random number between -1.0 and +1.0
-      for(int j=0; j<_lnunits[_r+k]; j++) {
-	_h_layers_w[k][i][j] = nrnd01() / static_cast<double>(_lnunits[_r+k]);
-	_prev_h_layers_w[k][i][j] = _h_layers_w[k][i][j];
-      }
-    }
-  }
+  if(_ios_tr)
+    for(int k=0; k<_s; k++, b++)
+      _h_layers_w[k] = _w.block(b);
 }
 
+/* Private: bind the weights views of a worker to those of its network */
 
-/* Private: Folding parts deallocation routine */
-template<class HA_Function, class OA_Function, class EMP> 
-void RecursiveNN<HA_Function, OA_Function, EMP>::deallocFoldingParts(double**** layers_w, double**** prev_layers_w, double**** layers_gradient_w, double*** delta_layers) {
-  if((*layers_w)[0]) {
-    for(int i=0; i<(_n+_v*_m) + 1; i++) {
-      if((*layers_w)[0][i]) {
-	delete[] (*layers_w)[0][i];
-	delete[] (*prev_layers_w)[0][i];
-      }
-      (*layers_w)[0][i] = 0; (*prev_layers_w)[0][i] = 0;
-    }
-    delete[] (*layers_w)[0]; delete[] (*prev_layers_w)[0];
-    (*layers_w)[0] = 0; (*prev_layers_w)[0] = 0;
-  }
-  if((*layers_gradient_w)[0]) {
-    for(int i=0; i<(_n+_v*_m) + 1; i++) {
-      if((*layers_gradient_w)[0][i])
-	delete[] (*layers_gradient_w)[0][i];
-      (*layers_gradient_w)[0][i] = 0;
-    }
-    delete[] (*layers_gradient_w)[0];
-    (*layers_gradient_w)[0] = 0;
-  }
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::shareWeights(const RecursiveNN* network) {
+  // views are rebound before each use, as the network may have
+  // swapped its weights buffers since (see rollback)
+  _layers_w = network->_layers_w;
+  _layers_wt = network->_layers_wt;
+  _g_layers_w = network->_g_layers_w;
+  _h_layers_w = network->_h_layers_w;
+}
 
-  if(_r > 1 && (*delta_layers)[0]) {
-    delete[] (*delta_layers)[0];
-    (*delta_layers)[0] = 0;
+/* Private: random weights initialisation routine */
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::initParameters() {
+  // Assign each weight a random number between -1.0 and +1.0,
+  // scaled by the number of units in the upper layer
+  for(int b=0; b<_layout.num_blocks(); ++b) {
+    Matrix<T> w = _w.block(b);
+    for(int i=0; i<w.rows(); i++)
+      for(int j=0; j<w.cols(); j++)
+	w[i][j] = nrnd01() / static_cast<double>(w.cols());
   }
+}
 
-  for(int k=1; k<_r; k++) {
-    if((*layers_w)[k]) {
-      for(int i=0; i<_lnunits[k-1]+1; i++) {
-	if((*layers_w)[k][i]) {
-	  delete[] (*layers_w)[k][i];
-	  delete[] (*prev_layers_w)[k][i];
-	}
-	(*layers_w)[k][i] = 0; (*prev_layers_w)[k][i] = 0;
-      }
-      delete[] (*layers_w)[k]; delete[] (*prev_layers_w)[k];
-      (*layers_w)[k] = 0; (*prev_layers_w)[k] = 0;
-    }
+/* Private: synchronise the output unit major copy of the folding weights */
 
-    if((*layers_gradient_w)[k]) {
-      for(int i=0; i<_lnunits[k-1]+1; i++) {
-	if((*layers_gradient_w)[k][i])
-	  delete[] (*layers_gradient_w)[k][i];
-	(*layers_gradient_w)[k][i] = 0;
-      }
-      delete[] (*layers_gradient_w)[k];
-      (*layers_gradient_w)[k] = 0;
-    }
-   
-    if(k < _r-1 && (*delta_layers)[k]) {
-      delete[] (*delta_layers)[k];
-      (*delta_layers)[k] = 0;
-    }
-  }
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::transposeFoldingWeights() {
+  if(_weights_layout != OUTPUT_MAJOR)
+    return;
   
-  delete[] *layers_w; delete[] *prev_layers_w;
-  delete[] *layers_gradient_w;
-  if(_r > 1 && *delta_layers) {
-    delete[] *delta_layers;
-    *delta_layers = 0;
-  }
-  *layers_w = 0; *prev_layers_w = 0; *layers_gradient_w = 0;
+  for(int o=0; o<_norient; ++o)
+    for(int k=0; k<_r; k++) {
+      Matrix<T>& w = _layers_w[o][k];
+      Matrix<T>& wt = _layers_wt[o][k];
+      for(int i=0; i<w.rows(); i++)
+	for(int j=0; j<w.cols(); j++)
+	  wt[j][i] = w[i][j];
+    }
 }
 
-/* Private: SS folding part deallocation routine */
-template<class HA_Function, class OA_Function, class EMP> 
-void RecursiveNN<HA_Function, OA_Function, EMP>::deallocSSPart() {
-  if(_g_layers_w[0]) {
-    for(int i=0; i<_norient*_m + 1; i++) {
-      if(_g_layers_w[0][i]) {
-	delete[] _g_layers_w[0][i];
-	delete[] _prev_g_layers_w[0][i];
-      }
-      _g_layers_w[0][i] = 0; _prev_g_layers_w[0][i] = 0;
-    }
-    delete[] _g_layers_w[0]; delete[] _prev_g_layers_w[0];
-    _g_layers_w[0] = 0; _prev_g_layers_w[0] = 0;
-  }
-  if(_g_layers_gradient_w[0]) {
-    for(int i=0; i<_norient*_m + 1; i++) {
-      if(_g_layers_gradient_w[0][i])
-	delete[] _g_layers_gradient_w[0][i];
-      _g_layers_gradient_w[0][i] = 0;
+/* Private: F folding part allocation routine */
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::allocFoldingParts(T*** delta_layers) {
+  // Assume constructor has initialized required dimension quantities
+  if(_r > 1) {
+    *delta_layers = new T*[_r-1];
+    for(int k=0; k<_r-1; k++) {
+      (*delta_layers)[k] = new T[_lnunits[k]];
+      memset((*delta_layers)[k], 0, (_lnunits[k]) * sizeof(T));
     }
-    delete[] _g_layers_gradient_w[0];
-    _g_layers_gradient_w[0] = 0;
   }
+}
 
-  if(_g_layers_activations[0]) {
-    delete[] _g_layers_activations[0];
-    _g_layers_activations[0] = 0;
-  }
+/* Private: SS tranforming part allocation routine */
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::allocSSPart() {
+  // Assume constructor has initialized required dimension quantities
+  _g_layers_activations.resize(_s);
+  _delta_g_layers.resize(_s);
 
-  if(_delta_g_layers[0]) {
-    delete[] _delta_g_layers[0];
-    _delta_g_layers[0] = 0;
+  // Reset g layers output activation units and delta values
+  // for a single instance, rows are added on demand for batches.
+  for(int k=0; k<_s; k++) {
+    _g_layers_activations[k].assign(_lnunits[_r+k], T(0));
+    _delta_g_layers[k].assign(_lnunits[_r+k], T(0));
   }
+}
 
-  for(int k=1; k<_s; k++) {
-    if(_g_layers_w[k]) {
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	if(_g_layers_w[k][i]) {
-	  delete[] _g_layers_w[k][i];
-	  delete[] _prev_g_layers_w[k][i];
-	}
-	_g_layers_w[k][i] = 0; _prev_g_layers_w[k][i] = 0;
-      }
-      delete[] _g_layers_w[k]; delete[] _prev_g_layers_w[k]; 
-      _g_layers_w[k] = 0; _prev_g_layers_w[k] = 0; 
-    }
-
-    if(_g_layers_gradient_w[k]) {
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	if(_g_layers_gradient_w[k][i])
-	  delete[] _g_layers_gradient_w[k][i];
-	_g_layers_gradient_w[k][i] = 0;
-      }
-      delete[] _g_layers_gradient_w[k];
-      _g_layers_gradient_w[k] = 0;
-    }
-    
-    if(_g_layers_activations[k]) {
-      delete[] _g_layers_activations[k];
-      _g_layers_activations[k] = 0;
-    }
+/* Private: IOS tranforming part allocation routine */
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::allocIOSPart() {
+  // Assume constructor has initialized required dimension quantities
+  _delta_h_layers = new T*[_s];
 
-    if(_delta_g_layers[k]) {
-      delete[] _delta_g_layers[k];
-      _delta_g_layers[k] = 0;
-    }
+  // Allocate and reset h layers delta values.
+  for(int k=0; k<_s; k++) {
+    _delta_h_layers[k] = new T[_lnunits[_r+k]];
+    memset(_delta_h_layers[k], 0, (_lnunits[_r+k])*sizeof(T));
   }
-  
-  delete[] _g_layers_w; delete[] _prev_g_layers_w;
-  delete[] _g_layers_gradient_w;
-  delete[] _g_layers_activations;
-  delete[] _delta_g_layers;
-  _g_layers_w = 0; _prev_g_layers_w = 0; _g_layers_gradient_w = 0;
-  _g_layers_activations = 0; _delta_g_layers = 0;
-
 }
 
 
-/* Private: IOS output map deallocation routine */
-template<class HA_Function, class OA_Function, class EMP> 
-void RecursiveNN<HA_Function, OA_Function, EMP>::deallocIOSPart() {
-  if(_h_layers_w[0]) {
-    for(int i=0; i<_norient*_m + _n + 1; i++) {
-      if(_h_layers_w[0][i]) {
-	delete[] _h_layers_w[0][i];
-	delete[] _prev_h_layers_w[0][i];
-      }
-      _h_layers_w[0][i] = 0; _prev_h_layers_w[0][i] = 0;
-    }
-    delete[] _h_layers_w[0]; delete[] _prev_h_layers_w[0];
-    _h_layers_w[0] = 0; _prev_h_layers_w[0] = 0;
-  }
-  if(_h_layers_gradient_w[0]) {
-    for(int i=0; i<_norient*_m + _n + 1; i++) {
-      if(_h_layers_gradient_w[0][i])
-	delete[] _h_layers_gradient_w[0][i];
-      _h_layers_gradient_w[0][i] = 0;
+/* Private: Folding parts deallocation routine */
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G> 
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::deallocFoldingParts(T*** delta_layers) {
+  if(_r > 1 && *delta_layers) {
+    for(int k=0; k<_r-1; k++) {
+      delete[] (*delta_layers)[k];
+      (*delta_layers)[k] = 0;
     }
-    delete[] _h_layers_gradient_w[0];
-    _h_layers_gradient_w[0] = 0;
-  }
-
-  if(_delta_h_layers[0]) {
-    delete[] _delta_h_layers[0];
-    _delta_h_layers[0] = 0;
+    delete[] *delta_layers;
+    *delta_layers = 0;
   }
+}
 
-  for(int k=1; k<_s; k++) {
-    if(_h_layers_w[k]) {
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	if(_h_layers_w[k][i]) {
-	  delete[] _h_layers_w[k][i];
-	  delete[] _prev_h_layers_w[k][i];
-	}
-	_h_layers_w[k][i] = 0; _prev_h_layers_w[k][i] = 0;
-      }
-      delete[] _h_layers_w[k]; delete[] _prev_h_layers_w[k]; 
-      _h_layers_w[k] = 0; _prev_h_layers_w[k] = 0; 
-    }
-
-    if(_h_layers_gradient_w[k]) {
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	if(_h_layers_gradient_w[k][i])
-	  delete[] _h_layers_gradient_w[k][i];
-	_h_layers_gradient_w[k][i] = 0;
-      }
-      delete[] _h_layers_gradient_w[k];
-      _h_layers_gradient_w[k] = 0;
-    }
-
-    if(_delta_h_layers[k]) {
-      delete[] _delta_h_layers[k];
-      _delta_h_layers[k] = 0;
-    }
+/* Private: IOS output map deallocation routine */
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G> 
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::deallocIOSPart() {
+  for(int k=0; k<_s; k++) {
+    delete[] _delta_h_layers[k];
+    _delta_h_layers[k] = 0;
   }
   
-  delete[] _h_layers_w; delete[] _prev_h_layers_w;
-  delete[] _h_layers_gradient_w;
   delete[] _delta_h_layers;
-  _h_layers_w = 0; _prev_h_layers_w = 0; _h_layers_gradient_w = 0;
   _delta_h_layers = 0;
 }
 
 /*** Gradient components resetting methods ***/
-template<class HA_Function, class OA_Function, class EMP>
-  void RecursiveNN<HA_Function, OA_Function, EMP>::resetGradientComponents() {
-
-  for(int i=0; i<_norient; ++i)
-    resetFoldingGradient(&(_layers_gradient_w[i]));
-
-  if(_ss_tr)
-    resetSSGradient();
-
-  if(_ios_tr)
-    resetIOSGradient();
-}
-
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::resetFoldingGradient(double**** layers_gradient_w) {
-  for(int i=0; i<(_n+_v*_m) + 1; i++)
-    memset((*layers_gradient_w)[0][i], 0, _lnunits[0] * sizeof(double));
-
-  for(int k=1; k<_r; k++)
-    for(int i=0; i<_lnunits[k-1]+1; i++)
-      memset((*layers_gradient_w)[k][i], 0, (_lnunits[k])*sizeof(double));
-
-}
-
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::resetSSGradient() {
-  for(int i=0; i<_norient*_m + 1; i++)
-    memset(_g_layers_gradient_w[0][i], 0, _lnunits[_r] * sizeof(double));
-
-  for(int k=1; k<_s; k++)
-    for(int i=0; i<_lnunits[_r+k-1]+1; i++)
-      memset(_g_layers_gradient_w[k][i], 0, (_lnunits[_r+k])*sizeof(double));
-
-}
-
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::resetIOSGradient() {
-  for(int i=0; i<_norient*_m + _n + 1; i++)
-    memset(_h_layers_gradient_w[0][i], 0, _lnunits[_r] * sizeof(double));
-
-  for(int k=1; k<_s; k++)
-    for(int i=0; i<_lnunits[_r+k-1]+1; i++)
-      memset(_h_layers_gradient_w[k][i], 0, (_lnunits[_r+k])*sizeof(double));
-}
-
-
-// Reset output values in g MLP layers
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::resetSSValues() {
-  for(int k=0; k<_s; k++) {
-    memset(_g_layers_activations[k], 0, (_lnunits[_r+k])*sizeof(double));
-  }
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::resetGradientComponents() {
+  // gradient components of all the parts of the network are stored contiguously
+  _gradient_w.reset();
 }
 
 
@@ -713,12 +674,25 @@ void RecursiveNN<HA_Function, OA_Function, EMP>::resetSSValues() {
     Obs: the input layer is constituted by n+v*m units grouped
     into a label part and parts for substructures.
 */
-template<class HA_Function, class OA_Function, class EMP> RecursiveNN<HA_Function, OA_Function, EMP>::RecursiveNN():
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G> RecursiveNN<HA_Function, OA_Function, EMP, T, G>::RecursiveNN():
   _norient(num_orientations(Options::instance()->domain())),
     _n(Options::instance()->input_dim()),
     _v(Options::instance()->domain_outdegree()),
-    _lnunits(Options::instance()->layers_number_units()) {
+    _lnunits(Options::instance()->layers_number_units()),
+    _rollback(false), _can_rollback(false), _line_search_set(0),
+    _weights_layout(weightsLayout()),
+    _schedule(Options::instance()->folding_schedule()),
+  _packed(Options::instance()->domain() == SEQUENCE || Options::instance()->domain() == LINEARCHAIN),
+  _grid(Options::instance()->domain() == GRID2D),
+  _implicit(_packed || _grid),
+  _nthreads(Options::instance()->num_threads()),
+  _orientation_schedule(Options::instance()->orientation_schedule()),
+  _parallel_training(Options::instance()->parallel_training()) {
     
+  // Vector kernels for the requested instruction set,
+  // by default the best one supported by the host
+  select_instruction_set(Options::instance()->instruction_set());
+
   // Get other fundamental parameters from Options class
   std::pair<int, int> indexes = Options::instance()->layers_indices();
   _r = indexes.first; _s = indexes.second;
@@ -752,13 +726,20 @@ template<class HA_Function, class OA_Function, class EMP> RecursiveNN<HA_Functio
   // Initialize random number generator
   srand(time(0));
 
-  _layers_w = new double***[_norient];
-  _prev_layers_w = new double***[_norient];
-  _layers_gradient_w = new double***[_norient];
-  _delta_layers = new double**[_norient];
+  // Allocate network parameters and assign
+  // weights a random number between -1.0 and +1.0
+  allocParameters();
+  initParameters();
+  transposeFoldingWeights();
   
+  _delta_layers = new T**[_norient];
   for(int i=0; i<_norient; ++i)
-    allocFoldingParts(&(_layers_w[i]), &(_prev_layers_w[i]), &(_layers_gradient_w[i]), &(_delta_layers[i]));
+    allocFoldingParts(&(_delta_layers[i]));
+  _workspaces.resize(_norient);
+  for(int o=0; o<_norient; ++o) {
+    _workspaces[o].activations.resize(_r);
+    _workspaces[o].deltas.resize(_r);
+  }
 
   if(_ss_tr)
     allocSSPart();
@@ -769,14 +750,26 @@ template<class HA_Function, class OA_Function, class EMP> RecursiveNN<HA_Functio
   // to decide whether or not to instantiate its b internal structures.
   _wu_method.setInternals(this);
 
-  ptn_la = &Node::_layers_activations;
-  ptn_dv = &Node::_delta_lr;
+  _activations.layout(_norient, _lnunits, _r, _s, _ios_tr);
   
 }
 
 /* Constructor */
-template<class HA_Function, class OA_Function, class EMP>
-  RecursiveNN<HA_Function, OA_Function, EMP>::RecursiveNN(const char* network_filename) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  RecursiveNN<HA_Function, OA_Function, EMP, T, G>::RecursiveNN(const char* network_filename):
+  _rollback(false), _can_rollback(false), _line_search_set(0),
+  _weights_layout(weightsLayout()),
+  _schedule(Options::instance()->folding_schedule()),
+  _packed(Options::instance()->domain() == SEQUENCE || Options::instance()->domain() == LINEARCHAIN),
+  _grid(Options::instance()->domain() == GRID2D),
+  _implicit(_packed || _grid),
+  _nthreads(Options::instance()->num_threads()),
+  _orientation_schedule(Options::instance()->orientation_schedule()),
+  _parallel_training(Options::instance()->parallel_training()) {
+  // Vector kernels for the requested instruction set,
+  // by default the best one supported by the host
+  select_instruction_set(Options::instance()->instruction_set());
+
   std::ifstream is(network_filename);
   assure(is, network_filename);
   
@@ -826,30 +819,31 @@ template<class HA_Function, class OA_Function, class EMP>
   is.precision(Options::instance()->precision());
   is.setf(std::ios::scientific);
 
-  _layers_w = new double***[_norient];
-  _prev_layers_w = new double***[_norient];
-  _layers_gradient_w = new double***[_norient];
-  _delta_layers = new double**[_norient];
-
+  // allocate network parameters, weights are always
+  // stored to file in input unit major order
+  allocParameters();
+  
   // allocate space for each folding direction
+  _delta_layers = new T**[_norient];
   for(int i=0; i<_norient; ++i)
-    allocFoldingParts(&(_layers_w[i]), &(_prev_layers_w[i]), &(_layers_gradient_w[i]), &(_delta_layers[i]));
+    allocFoldingParts(&(_delta_layers[i]));
+  _workspaces.resize(_norient);
+  for(int o=0; o<_norient; ++o) {
+    _workspaces[o].activations.resize(_r);
+    _workspaces[o].deltas.resize(_r);
+  }
 
   // read weights for each folding direction
   for(int o=0; o<_norient; ++o) {
     for(int i=0; i<(_n+_v*_m) + 1; i++) {
-      for(int j=0; j<_lnunits[0]; j++) {
-	is >> _layers_w[o][0][i][j]; 
-	_prev_layers_w[o][0][i][j] = _layers_w[o][0][i][j]; 
-      }
+      for(int j=0; j<_lnunits[0]; j++)
+	is >> _layers_w[o][0][i][j];
     }
   
     for(int k=1; k<_r; k++) {
       for(int i=0; i<_lnunits[k-1]+1; i++) {
-	for(int j=0; j<_lnunits[k]; j++) {
+	for(int j=0; j<_lnunits[k]; j++)
 	  is >> _layers_w[o][k][i][j];
-	  _prev_layers_w[o][k][i][j] = _layers_w[o][k][i][j];
-	}
       }
     }
   }
@@ -859,17 +853,13 @@ template<class HA_Function, class OA_Function, class EMP>
     allocSSPart();
     
     for(int i=0; i<_norient*_m + 1; i++)
-      for(int j=0; j<_lnunits[_r]; j++) {
+      for(int j=0; j<_lnunits[_r]; j++)
 	is >> _g_layers_w[0][i][j];
-	_prev_g_layers_w[0][i][j] = _g_layers_w[0][i][j];
-      }
   
     for(int k=1; k<_s; k++) {
       for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	for(int j=0; j<_lnunits[_r+k]; j++) {
+	for(int j=0; j<_lnunits[_r+k]; j++)
 	  is >> _g_layers_w[k][i][j];
-	  _prev_g_layers_w[k][i][j] = _g_layers_w[k][i][j];
-	}
       }  
     }
   }
@@ -879,39 +869,75 @@ template<class HA_Function, class OA_Function, class EMP>
     allocIOSPart();
 
     for(int i=0; i<_norient*_m + _n + 1; i++)
-      for(int j=0; j<_lnunits[_r]; j++) {
+      for(int j=0; j<_lnunits[_r]; j++)
 	is >> _h_layers_w[0][i][j];
-	_prev_h_layers_w[0][i][j] = _h_layers_w[0][i][j];
-      }
   
     for(int k=1; k<_s; k++) {
       for(int i=0; i<_lnunits[_r+k-1]+1; i++) {
-	for(int j=0; j<_lnunits[_r+k]; j++) {
+	for(int j=0; j<_lnunits[_r+k]; j++)
 	  is >> _h_layers_w[k][i][j];
-	  _prev_h_layers_w[k][i][j] = _h_layers_w[k][i][j];
-	}
       }
     }
   }
 
+  transposeFoldingWeights();
+
   // Allocate weight update method structures
   _wu_method.setInternals(this);
 
-  ptn_la = &Node::_layers_activations;
-  ptn_dv = &Node::_delta_lr;
+  _activations.layout(_norient, _lnunits, _r, _s, _ios_tr);
 
 }
 
 
-/* Destructor */
-template<class HA_Function, class OA_Function, class EMP>
-RecursiveNN<HA_Function, OA_Function, EMP>::~RecursiveNN() {
+/* Private constructor: a worker of the given network */
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  RecursiveNN<HA_Function, OA_Function, EMP, T, G>::RecursiveNN(const RecursiveNN* network):
+  _ss_tr(network->_ss_tr), _ios_tr(network->_ios_tr), _problem(network->_problem),
+  _norient(network->_norient), _n(network->_n), _v(network->_v), _m(network->_m),
+  _q(network->_q), _r(network->_r), _s(network->_s), _lnunits(network->_lnunits),
+  _rollback(false), _can_rollback(false), _line_search_set(0),
+  // asynchronous workers read the weights while they are updated:
+  // there is no consistent transposed copy
+  _weights_layout(network->_parallel_training == ASYNCHRONOUS_TRAINING?INPUT_MAJOR:network->_weights_layout),
+  _schedule(network->_schedule), _packed(network->_packed), _grid(network->_grid),
+  _implicit(network->_implicit),
+  // workers already run in parallel
+  _nthreads(1), _orientation_schedule(SEQUENTIAL_ORIENTATIONS),
+  _parallel_training(SERIAL_TRAINING) {
+  // a gradient buffer of its own, the weights
+  // are those of the network (see shareWeights)
+  allocParameters(false);
+  if(network->_parallel_training == ASYNCHRONOUS_TRAINING)
+    _momentum_w.allocate(_layout);
+
+  _delta_layers = new T**[_norient];
   for(int i=0; i<_norient; ++i)
-    deallocFoldingParts(&(_layers_w[i]), &(_prev_layers_w[i]), &(_layers_gradient_w[i]), &(_delta_layers[i]));
+    allocFoldingParts(&(_delta_layers[i]));
+  _workspaces.resize(_norient);
+  for(int o=0; o<_norient; ++o) {
+    _workspaces[o].activations.resize(_r);
+    _workspaces[o].deltas.resize(_r);
+  }
 
   if(_ss_tr)
-    deallocSSPart();
-  
+    allocSSPart();
+  if(_ios_tr)
+    allocIOSPart();
+
+  _activations.layout(_norient, _lnunits, _r, _s, _ios_tr);
+}
+
+/* Destructor */
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+RecursiveNN<HA_Function, OA_Function, EMP, T, G>::~RecursiveNN() {
+  for(uint t=0; t<_workers.size(); ++t)
+    delete _workers[t];
+
+  for(int i=0; i<_norient; ++i)
+    deallocFoldingParts(&(_delta_layers[i]));
+  delete[] _delta_layers; _delta_layers = 0;
+
   if(_ios_tr)
     deallocIOSPart();
   
@@ -924,28 +950,65 @@ RecursiveNN<HA_Function, OA_Function, EMP>::~RecursiveNN() {
   representation at root node ouput layers and evaluate it
   with the ouptput (g) function.
 */
-template<class HA_Function, class OA_Function, class EMP>
-  void RecursiveNN<HA_Function, OA_Function, EMP>::propagateStructuredInput(Instance* instance) {  
-  // Reset output activations in nodes layers
-  // if _ios_tr is set h output activations are reset
-  instance->resetNodeOutputActivations();
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::propagateStructuredInput(Instance* instance) {  
+  propagateInstances(&instance, &instance+1);
+}
 
-  // Reset output activations in output (g) function MLP layers
-  if(_ss_tr)
-    resetSSValues();
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::propagateStructuredInput(DataSet::const_iterator first, DataSet::const_iterator last) {
+  if(first != last)
+    propagateInstances(&*first, &*first + (last-first));
+}
 
-  // Structure propagation by unfolding into casual parts
-  for(int i=0; i<_norient; ++i)
-    propagateInputOnFoldingPart(instance, i); //toNodes, sdags[0], sdags_top_ords[0], &_f_layers_w, ptn_fla);
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::propagateInstances(Instance* const* first, Instance* const* last) {
+  // Room for the activations of the nodes of the instances:
+  // all of them are written before being read, no reset
+  _activations.assign(first, last);
+
+  // The node labels contribution to the first layer does not depend
+  // on the recursion: it is computed for all the nodes beforehand
+  gatherLabels(first, last);
+
+  bool packed = _packed && _schedule == LEVEL_SCHEDULE;
+  if(packed)
+    packSequences(first, last);
+
+  // The orientations do not share anything but the labels: when
+  // they run concurrently, each has its share of the threads
+  bool concurrent = concurrentOrientations();
+  const int nthreads = concurrent?std::max(1, _nthreads/_norient):_nthreads;
+  
+  // Structure propagation by unfolding into casual parts,
+  // joined before evaluating the output networks
+  _pool.run(_norient, concurrent?_norient:1, [&](int i) {
+      projectLabels(i);
+
+      if(packed)
+	propagateSequencesOnFoldingPart(i);
+      else if(_schedule == LEVEL_SCHEDULE)
+	propagateLevelsOnFoldingPart(first, last, i, nthreads);
+      else {
+	const T* projections = &_workspaces[i].projections[0];
+	for(Instance* const* it=first; it!=last; ++it) {
+	  propagateInputOnFoldingPart(*it, i, projections);
+	  projections += (*it)->num_nodes()*_lnunits[0];
+	}
+      }
+    });
   
-  // Evaluate current encoded structure (if supersource trasd.)
+  // Evaluate current encoded structures (if supersource trasd.)
   if(_ss_tr)
-    gPropagateInput(instance); // toNodes, sdags, sdags_top_ords);
+    gPropagateInput(first, last);
 
   // Compute output label for each node (if io-isomorf trasd.)
   if(_ios_tr)
-    for(uint n=0; n<instance->num_nodes(); ++n)
-      hPropagateInput(instance->node(n));
+    for(Instance* const* it=first; it!=last; ++it) {
+      NodeActivations<T>* na = _activations.nodes(*it);
+      for(uint n=0; n<(*it)->num_nodes(); ++n)
+	hPropagateInput((*it)->node(n), na[n]);
+    }
 
 }
 
@@ -954,204 +1017,437 @@ template<class HA_Function, class OA_Function, class EMP>
  * Private methods *
  *******************/
 
-template<class HA_Function, class OA_Function, class EMP>
-  void RecursiveNN<HA_Function, OA_Function, EMP>::propagateInputOnFoldingPart(Instance* instance, int o) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::gatherLabels(Instance* const* first, Instance* const* last) {
+  int nn = 0;
+  for(Instance* const* it=first; it!=last; ++it)
+    nn += (*it)->num_nodes();
+
+  // one row for each node, instances in order
+  _labels.resize(nn*_n);
+  for(int o=0; o<_norient; ++o)
+    _workspaces[o].projections.resize(nn*_lnunits[0]);
+
+  T* x = _labels.data();
+  for(Instance* const* it=first; it!=last; ++it)
+    for(uint t=0; t<(*it)->num_nodes(); ++t, x+=_n) {
+      Node* node = (*it)->node(t);
+      require(_n == node->input_dim(), "Error in Node input dimension\n");
+      std::copy(node->input_data(), node->input_data() + _n, x);
+    }
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::projectLabels(int o) {
+  FoldingWorkspace& ws = _workspaces[o];
+  // The contribution of the labels to the net input of the units
+  // in the first layer: the labels times the first _n rows of
+  // the weights, for all the nodes with a single product.
+  const int nn = ws.projections.size()/_lnunits[0];
+  Matrix<T>& w = _layers_w[o][0];
+
+  std::fill(ws.projections.begin(), ws.projections.end(), T(0));
+  gemm_nn(nn, _lnunits[0], _n, T(1), _labels.data(), _n, w.data(), w.stride(),
+	  ws.projections.data(), _lnunits[0]);
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::propagateInputOnFoldingPart(Instance* instance, int o, const T* projections) {
+  FoldingWorkspace& ws = _workspaces[o];
   // A structured input is a sequence of nodes and a DAG with that vertices.
   // Nodes are passed by (non-const) reference to allow the net
   // storing output activations on each node for all of the folding layers. 
 
-  DPAG* dpag = instance->orientation(o);
-    
-  Vertex_d currentNode;
-  //VertexId vertex_id = boost::get(boost::vertex_index, *dpag);
-  EdgeId edge_id = boost::get(boost::edge_index, *dpag);
-  outIter out_i, out_end;
-
-  std::vector<int> top_ord = instance->topological_order(o);
+  const int ni = _n + _v*_m;
+  ws.inputs.resize(ni);
+  NodeActivations<T>* na = _activations.nodes(instance);
+
+  // Nodes in reverse topological order: for implicit
+  // instances, level by level, leaves first
+  Instance::OrientationRef orientation;
+  if(!_implicit)
+    orientation = instance->oriented(o);
+  const int nn = instance->num_nodes();
+  uint l = 0;
+  int pos = 0; // of the next node in level l
   
-  for(std::vector<int>::const_reverse_iterator r_it=top_ord.rbegin(); r_it!=top_ord.rend(); ++r_it) {
-    int t = *r_it;
-
-    Node* node = instance->node(t);
-    currentNode = boost::vertex(t, *dpag);
-    require(_n == node->input_dim(), "Error in Node input dimension\n");
+  for(int n=0; n<nn; ++n) {
+    int t;
+    if(_implicit) {
+      t = instance->level_node(o, l, pos);
+      if(++pos == instance->level_size(o, l)) {
+	++l;
+	pos = 0;
+      }
+    } else
+      t = orientation->order[nn-1-n];
 
-    // Remember: if k==1 (0 according to the indexing scheme) 
+    // Remember: in the first layer (layer index k==0 below)
     // net input for each unit comes both from current node 
     // immediate successors and from the node input label.
-
-    // We are in layer k == 1.
-    // for each unit in layer 1 (0)
-    for(int j=0; j<_lnunits[0]; j++) {
-      // calculate weighted sum of its inputs
-      double unit_input = 0.0;
-      // firstly take into account current node input label
-      for(int i=0; i<_n; i++) {
-	unit_input += 
-	  _layers_w[o][0][i][j] * node->_encodedInput[i];
-      }
-
-      // add to weighted sum contribution of the previously
-      // computed representations of the immediate substructures.
-      // Eliminate control on max outdegree.
-      // Ignore edges whose id is greater than max outdegree.
-      for(boost::tie(out_i, out_end)=out_edges(currentNode, *dpag); 
-	  out_i!=out_end && edge_id[*out_i] < (uint)_v; ++out_i) {
-	//require(0<=edge_id[*out_i] && edge_id[*out_i] < _v, "Valence assertion failed!");
-	Node* successor = instance->node(target(*out_i, *dpag));
-
-	for(uint i=_n + edge_id[*out_i]*_m; i<_n + _m*(edge_id[*out_i] + 1); i++)
-	  unit_input +=
-	    _layers_w[o][0][i][j] *
-	    successor->_layers_activations[o][_r-1][(i-_n)%_m];
-	  // or (instance->node(target(*out_i, *dpag))->*ptn_la)[o][_r-1][(i-_n)%_m];
-	
+    // The label contribution has already been computed, so
+    // start from the first representation of a child (i0).
+    gatherNodeInputs(instance, orientation?&orientation->graph:0, na, o, t, &ws.inputs[0]);
+
+    const T* in = &ws.inputs[0];
+    int nin = ni;
+    for(int k=0; k<_r; k++) {
+      T* a = na[t]._layers_activations[o][k];
+      const T* p = k?0:projections + t*_lnunits[0];
+      const int i0 = k?0:_n;
+
+      if(_weights_layout == OUTPUT_MAJOR) {
+	// incoming weights of each unit are contiguous, threshold
+	// unit weight last: the weighted sum is a dot product
+	for(int j=0; j<_lnunits[k]; j++) {
+	  const T* w_j = _layers_wt[o][k][j];
+	  a[j] = evaluate(haf, (p?p[j]:T(0)) + dot(nin-i0, w_j+i0, in+i0) + w_j[nin]);
+	}
+      } else {
+	// add the outgoing weights of each input unit to the weighted
+	// sums of all the units, threshold unit weight is the last row
+	Matrix<T>& w = _layers_w[o][k];
+	if(p)
+	  std::copy(p, p + _lnunits[k], a);
+	else
+	  std::fill(a, a + _lnunits[k], T(0));
+	for(int i=i0; i<nin; i++)
+	  axpy(_lnunits[k], in[i], w[i], a);
+	for(int j=0; j<_lnunits[k]; j++)
+	  a[j] = evaluate(haf, a[j] + w[nin][j]);
       }
 
-      // if there are less children than the valence, missing children encoding 
-      // (base step of recursion, 0) does not influence current unit input.
-      // So do not add 0 to the sum.
-      
-      // Add threshold unit contribution (input == 1).
-      // We assume threshold unit weight is last component
-      // of the weight matrix.
-      unit_input += _layers_w[o][0][_n+_v*_m][j];
-
-      // calculate unit output activation
-      node->_layers_activations[o][0][j] = evaluate(haf, unit_input);
-      // or (node->*ptn_la)[o][0][j] = evaluate(haf, unit_input);
+      in = a;
+      nin = _lnunits[k];
     }
+  }
+}
 
-    for(int k=1; k<_r; k++) {
-      // for each unit in layer k
-      for(int j=0; j<_lnunits[k]; j++) {
-	// calculate weighted sum of its input
-	double unit_input = 0.0;
-	for(int i=0; i<_lnunits[k-1]; i++) {
-	  unit_input += _layers_w[o][k][i][j] * node->_layers_activations[o][k-1][i];
-	}
-	// Add threshold unit contribution (input == 1),
-	// last component of the weight matrix.
-	unit_input += _layers_w[o][k][_lnunits[k-1]][j];
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::holdOrientations(Instance* const* first, Instance* const* last, int o) {
+  // the levels and the children of the nodes of implicit
+  // instances follow from their shape, no orientation is needed
+  std::vector<Instance::OrientationRef>& orientations = _workspaces[o].orientations;
+  orientations.clear();
+  if(!_implicit)
+    for(Instance* const* it=first; it!=last; ++it)
+      orientations.push_back((*it)->oriented(o));
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  uint RecursiveNN<HA_Function, OA_Function, EMP, T, G>::numLevels(Instance* const* first, Instance* const* last, int o) {
+  // levels of the highest instance
+  uint nlevels = 0;
+  for(Instance* const* it=first; it!=last; ++it)
+    nlevels = std::max(nlevels, _implicit?
+		       (*it)->num_levels(o):
+		       (uint)_workspaces[o].orientations[it-first]->levels.size());
 
-	// calculate unit output activation
-	node->_layers_activations[o][k][j] = evaluate(haf, unit_input);
+  return nlevels;
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  int RecursiveNN<HA_Function, OA_Function, EMP, T, G>::gatherLevelNodes(Instance* const* first, Instance* const* last, int o, uint l) {
+  FoldingWorkspace& ws = _workspaces[o];
+  // Nodes at height l in orientation o of each instance,
+  // in the same order as in the level of each instance
+  ws.nodes.clear();
+  ws.rows.clear();
+  ws.buffers.clear();
+  ws.graphs.clear();
+
+  int offset = 0; // first row of the instance in the label projections
+  for(Instance* const* it=first; it!=last; offset+=(*it)->num_nodes(), ++it) {
+    NodeActivations<T>* na = _activations.nodes(*it);
+    if(_implicit) {
+      if(l >= (*it)->num_levels(o))
+	continue;
+
+      for(int k=0; k<(*it)->level_size(o, l); ++k) {
+	int t = (*it)->level_node(o, l, k);
+	ws.nodes.push_back(std::make_pair(*it, t));
+	ws.rows.push_back(offset + t);
+	ws.buffers.push_back(na);
+	ws.graphs.push_back(0);
       }
+      continue;
+    }
+
+    const Instance::Orientation& orientation = *ws.orientations[it-first];
+    const std::vector<std::vector<int> >& levels = orientation.levels;
+    if(l >= levels.size())
+      continue;
+
+    for(uint t=0; t<levels[l].size(); ++t) {
+      ws.nodes.push_back(std::make_pair(*it, levels[l][t]));
+      ws.rows.push_back(offset + levels[l][t]);
+      ws.buffers.push_back(na);
+      ws.graphs.push_back(&orientation.graph);
     }
   }
+
+  return ws.nodes.size();
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-  void RecursiveNN<HA_Function, OA_Function, EMP>::gPropagateInput(Instance* instance) {
-  
-  for(int j=0; j<_lnunits[_r]; j++) {
-    // calculate weighted sum of its inputs
-    double unit_input = 0.0;
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::gatherNodeInputs(Instance* instance, const CSRGraph* graph, NodeActivations<T>* na, int o, int t, T* x) {
+  Node* node = instance->node(t);
+  require(_n == node->input_dim(), "Error in Node input dimension\n");
+
+  // The node input label followed by the representations of its
+  // immediate successors, each at the position given by the edge.
+  // Missing children encoding (base step of recursion) is 0.
+  std::copy(node->input_data(), node->input_data() + _n, x);
+  std::fill(x + _n, x + _n + _v*_m, T(0));
+
+  if(_implicit) {
+    int children[2];
+    const int nc = std::min(instance->children(o, t, children), _v);
+    for(int c=0; c<nc; ++c) {
+      const T* rep = na[children[c]]._layers_activations[o][_r-1];
+      std::copy(rep, rep + _m, x + _n + c*_m);
+    }
+    return;
+  }
 
-    // add to weighted sum contribution of the previously
-    // computed representations of the super-source nodes
-    // defined for each possible orientation
-    for(int o=0; o<_norient; ++o) {
-      // the first node in the topological order of each orientation
-      // is a super-source node which contributes to the activation
-      // of the units of the MLP implementing the super-source transduction
-      Node* node = instance->node((instance->topological_orders())[o][0]);
-      for(int i=o*_m; i<(o+1)*_m; ++i)
-	unit_input +=
-	  _g_layers_w[0][i][j] * node->_layers_activations[o][_r-1][i-o*_m];
+  // Ignore edges whose id is greater than max outdegree.
+  for(int c=graph->out_begin(t); c<graph->out_end(t); ++c) {
+    if(graph->position(c) >= _v)
+      continue;
+      
+    const T* rep = na[graph->target(c)]._layers_activations[o][_r-1];
+    std::copy(rep, rep + _m, x + _n + graph->position(c)*_m);
+  }
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::propagateLevelsOnFoldingPart(Instance* const* first, Instance* const* last, int o, int nthreads) {
+  FoldingWorkspace& ws = _workspaces[o];
+  // Nodes with the same height do not depend on each other: each level,
+  // leaves first, goes through each layer as a single matrix product.
+  // The levels of different instances are merged into the same blocks,
+  // whose rows are split among the threads.
+  holdOrientations(first, last, o);
+  const uint nlevels = numLevels(first, last, o);
+
+  for(uint l=0; l<nlevels; ++l) {
+    const int nb = gatherLevelNodes(first, last, o, l);
+
+    ws.inputs.resize(nb*(_n + _v*_m));
+    for(int k=0; k<_r; k++)
+      ws.activations[k].resize(nb*_lnunits[k]);
+
+    const int nchunks = numChunks(nb, nthreads);
+    ws.pool.run(nchunks, nthreads, [&](int c) {
+	propagateLevelRows(o, c*nb/nchunks, (c+1)*nb/nchunks);
+      });
+  }
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::propagateLevelRows(int o, int b0, int b1) {
+  FoldingWorkspace& ws = _workspaces[o];
+  // Forward rows [b0, b1) of the current level: rows do not depend on
+  // each other and are computed the same whatever block they are in
+  const int nb = b1 - b0;
+  int ni = _n + _v*_m;
+  for(int b=b0; b<b1; ++b)
+    gatherNodeInputs(ws.nodes[b].first, ws.graphs[b], ws.buffers[b], o, ws.nodes[b].second, &ws.inputs[b*ni]);
+
+  const T* in = &ws.inputs[b0*ni];
+  for(int k=0; k<_r; k++) {
+    T* y = &ws.activations[k][b0*_lnunits[k]];
+    Matrix<T>& w = _layers_w[o][k];
+      
+    // weighted sum of the inputs of each unit for all the nodes:
+    // in the first layer, start from the contribution of the labels
+    // and add that of the representations of the children
+    int i0 = 0;
+    if(k == 0) {
+      for(int b=0; b<nb; ++b)
+	std::copy(&ws.projections[ws.rows[b0+b]*_lnunits[0]],
+		  &ws.projections[(ws.rows[b0+b]+1)*_lnunits[0]], y + b*_lnunits[0]);
+      i0 = _n;
+    } else
+      std::fill(y, y + nb*_lnunits[k], T(0));
+    gemm_nn(nb, _lnunits[k], ni-i0, T(1), in+i0, ni, w[i0], w.stride(), y, _lnunits[k]);
+
+    // Add threshold unit contribution (last row of the weight matrix),
+    // then store the unit output activations also at the node level.
+    const T* threshold = w[ni];
+    for(int b=0; b<nb; ++b) {
+      T* y_b = y + b*_lnunits[k];
+      T* a = ws.buffers[b0+b][ws.nodes[b0+b].second]._layers_activations[o][k];
+      for(int j=0; j<_lnunits[k]; j++)
+	a[j] = y_b[j] = evaluate(haf, y_b[j] + threshold[j]);
     }
-    
-    // Add threshold unit contribution (input == 1).
-    // We assume threshold unit weight is last component
-    // of the weight matrix.
-    unit_input += _g_layers_w[0][_norient*_m][j];
-
-    // calculate units output activation
-    if(0 < _s-1) 
-      _g_layers_activations[0][j] = evaluate(haf, unit_input);
-    else
-      _g_layers_activations[0][j] = evaluate(oaf, unit_input);
+
+    in = y;
+    ni = _lnunits[k];
   }
+}
 
-  for(int k=1; k<_s; k++) {
-    // for each unit in layer k
-    for(int j=0; j<_lnunits[_r+k]; j++) {
-      // calculate weighted sum of its input
-      double unit_input = 0.0;
-      for(int i=0; i<_lnunits[_r+k-1]; i++) {
-	unit_input += 
-	  _g_layers_w[k][i][j] * _g_layers_activations[k-1][i];
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::packSequences(Instance* const* first, Instance* const* last) {
+  _sequences.clear();
+
+  int offset = 0;
+  for(Instance* const* it=first; it!=last; ++it) {
+    PackedSequence seq = { *it, (int)(*it)->num_nodes(), offset, _activations.nodes(*it) };
+    _sequences.push_back(seq);
+    offset += seq.length;
+  }
+
+  // sequences with the same length keep their order
+  std::stable_sort(_sequences.begin(), _sequences.end());
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::propagateSequencesOnFoldingPart(int o) {
+  FoldingWorkspace& ws = _workspaces[o];
+  // Sequences are packed time-major: each time step, starting from
+  // the leaves, goes through each layer as a single matrix product
+  // over the sequences still active. No graph is involved, the child
+  // of an element is the one processed at the previous step.
+  const int nsteps = _sequences.empty()?0:_sequences[0].length;
+  int nb = _sequences.size();
+
+  for(int s=0; s<nsteps; ++s) {
+    // sequences shorter than s+1 elements are over
+    while(_sequences[nb-1].length <= s)
+      --nb;
+
+    int ni = _n + _v*_m;
+    for(int k=0; k<_r; k++) {
+      std::vector<T>& y = ws.activations[k];
+      Matrix<T>& w = _layers_w[o][k];
+      
+      y.resize(nb*_lnunits[k]);
+      if(k == 0) {
+	// contribution of the labels, then that of the representations
+	// computed at the previous step (base step of recursion: none)
+	for(int b=0; b<nb; ++b) {
+	  const PackedSequence& seq = _sequences[b];
+	  const T* p = &ws.projections[(seq.offset + sequenceNode(seq, o, s))*_lnunits[0]];
+	  std::copy(p, p + _lnunits[0], &y[b*_lnunits[0]]);
+	}
+	if(s > 0 && _v > 0)
+	  gemm_nn(nb, _lnunits[0], _m, T(1), &ws.states[0], _m, w[_n], w.stride(), &y[0], _lnunits[0]);
+      } else {
+	std::fill(y.begin(), y.end(), T(0));
+	gemm_nn(nb, _lnunits[k], ni, T(1), &ws.activations[k-1][0], ni, w.data(), w.stride(), &y[0], _lnunits[k]);
       }
 
-      // Add threshold unit contribution (input == 1),
-      // last component of the weight matrix.
-      unit_input += _g_layers_w[k][_lnunits[_r+k-1]][j];
+      // Add threshold unit contribution (last row of the weight matrix),
+      // then store the unit output activations also at the node level.
+      const T* threshold = w[ni];
+      for(int b=0; b<nb; ++b) {
+	T* y_b = &y[b*_lnunits[k]];
+	T* a = _sequences[b].nodes[sequenceNode(_sequences[b], o, s)]._layers_activations[o][k];
+	for(int j=0; j<_lnunits[k]; j++)
+	  a[j] = y_b[j] = evaluate(haf, y_b[j] + threshold[j]);
+      }
 
-      // calculate unit output activation,
-      // take into account being in hidden or output units.
-      if(k < _s-1)
-	_g_layers_activations[k][j] = evaluate(haf, unit_input);
-      else
-	_g_layers_activations[k][j] = evaluate(oaf, unit_input);
+      ni = _lnunits[k];
     }
+
+    // representations of the children of the next step
+    ws.states.swap(ws.activations[_r-1]);
   }
 }
 
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::gatherSuperSources(Instance* const* first, Instance* const* last) {
+  const int ni = _norient*_m;
+  _g_inputs.resize((last-first)*ni);
 
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::hPropagateInput(Node* n) {
-  
-  for(int j=0; j<_lnunits[_r]; j++) {
-    // calculate weighted sum of its inputs
-    double unit_input = 0.0;
-
-    // add to weighted sum contribution of the previously
-    // computed representations of the node defined for
-    // each possible orientation
+  for(Instance* const* it=first; it!=last; ++it)
     for(int o=0; o<_norient; ++o) {
-      for(int i=o*_m; i<(o+1)*_m; ++i)
-	unit_input +=
-	  _h_layers_w[0][i][j] * n->_layers_activations[o][_r-1][i-o*_m];
+      // the first node in the topological order of each orientation
+      // is a super-source node which contributes to the activation
+      // of the units of the MLP implementing the super-source transduction
+      const NodeActivations<T>& root = _activations.nodes(*it)[(*it)->root(o)];
+      const T* rep = root._layers_activations[o][_r-1];
+      std::copy(rep, rep + _m, &_g_inputs[(it-first)*ni + o*_m]);
     }
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::gPropagateInput(Instance* const* first, Instance* const* last) {
+  const int nb = last-first;
 
-    // Output label depend also on current node encoded input
-    for(int i=_norient*_m; i<_norient*_m + _n; i++)
-      unit_input +=
-	_h_layers_w[0][i][j] * n->_encodedInput[i-_norient*_m];
-
-    // Add threshold unit contribution (input == 1).
-    // We assume threshold unit weight is last component
-    // of the weight matrix.
-    unit_input += _h_layers_w[0][_norient*_m+_n][j];
-
-    // calculate units output activation
-    if(0 < _s-1) 
-      n->_h_layers_activations[0][j] = evaluate(haf, unit_input);
-    else
-      n->_h_layers_activations[0][j] = evaluate(oaf, unit_input);
+  // add to weighted sum contribution of the previously
+  // computed representations of the super-source nodes
+  // defined for each possible orientation
+  gatherSuperSources(first, last);
+
+  const T* in = &_g_inputs[0];
+  int ni = _norient*_m;
+  for(int k=0; k<_s; k++) {
+    std::vector<T>& y = _g_layers_activations[k];
+    Matrix<T>& w = _g_layers_w[k];
+    const int nu = _lnunits[_r+k];
+
+    // calculate weighted sum of the inputs of each unit for all the instances
+    y.assign(nb*nu, T(0));
+    gemm_nn(nb, nu, ni, T(1), in, ni, w.data(), w.stride(), &y[0], nu);
+
+    // Add threshold unit contribution (input == 1), last row
+    // of the weight matrix, then calculate unit output activation,
+    // take into account being in hidden or output units.
+    const T* threshold = w[ni];
+    for(int b=0; b<nb; ++b)
+      for(int j=0; j<nu; j++)
+	if(k < _s-1)
+	  y[b*nu + j] = evaluate(haf, y[b*nu + j] + threshold[j]);
+	else
+	  y[b*nu + j] = evaluate(oaf, y[b*nu + j] + threshold[j]);
+
+    in = &y[0];
+    ni = nu;
   }
+}
 
-  for(int k=1; k<_s; k++) {
-    // for each unit in layer k
-    for(int j=0; j<_lnunits[_r+k]; j++) {
-      // calculate weighted sum of its input
-      double unit_input = 0.0;
-      for(int i=0; i<_lnunits[_r+k-1]; i++) {
-	unit_input += 
-	  _h_layers_w[k][i][j] * n->_h_layers_activations[k-1][i];
-      }
 
-      // Add threshold unit contribution (input == 1),
-      // last component of the weight matrix.
-      unit_input += _h_layers_w[k][_lnunits[_r+k-1]][j];
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::gatherOutputInputs(Node* n, const NodeActivations<T>& na) {
+  // the representations of the node defined for each
+  // possible orientation, followed by the node input label
+  _h_inputs.resize(_norient*_m + _n);
+  for(int o=0; o<_norient; ++o)
+    std::copy(na._layers_activations[o][_r-1], na._layers_activations[o][_r-1] + _m, &_h_inputs[o*_m]);
+  std::copy(n->input_data(), n->input_data() + n->input_dim(), &_h_inputs[_norient*_m]);
+}
 
-      // calculate unit output activation,
-      // take into account being in hidden or output units.
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::hPropagateInput(Node* n, NodeActivations<T>& na) {
+  // Output label depend on the node representations
+  // and also on current node encoded input
+  gatherOutputInputs(n, na);
+
+  const T* in = &_h_inputs[0];
+  int nin = _norient*_m + _n;
+  for(int k=0; k<_s; k++) {
+    T* a = na._h_layers_activations[k];
+    Matrix<T>& w = _h_layers_w[k];
+
+    // calculate weighted sum of the inputs of each unit
+    std::fill(a, a + _lnunits[_r+k], T(0));
+    for(int i=0; i<nin; i++)
+      axpy(_lnunits[_r+k], in[i], w[i], a);
+
+    // Add threshold unit contribution (input == 1),
+    // last component of the weight matrix, and calculate
+    // unit output activation, take into account being
+    // in hidden or output units.
+    for(int j=0; j<_lnunits[_r+k]; j++)
       if(k < _s-1)
-	n->_h_layers_activations[k][j] = evaluate(haf, unit_input);
+	a[j] = evaluate(haf, a[j] + w[nin][j]);
       else
-	n->_h_layers_activations[k][j] = evaluate(oaf, unit_input);
-    }
+	a[j] = evaluate(oaf, a[j] + w[nin][j]);
+
+    in = a;
+    nin = _lnunits[_r+k];
   }
 
 }
@@ -1159,31 +1455,187 @@ void RecursiveNN<HA_Function, OA_Function, EMP>::hPropagateInput(Node* n) {
 
 /*** Public Functions ***/
 
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::backPropagateError(Instance* instance) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::backPropagateError(Instance* instance) {
+  backPropagateInstances(&instance, &instance+1);
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::backPropagateError(DataSet::const_iterator first, DataSet::const_iterator last) {
+  if(first != last)
+    backPropagateInstances(&*first, &*first + (last-first));
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::backPropagateInstances(Instance* const* first, Instance* const* last) {
   // if io-isomorf trasduction, compute for each node error of h map,
   // so as to add it to deltas error in representation layers coming
   // from node parents (with respect to f and b ordering)
   if(_ios_tr)
-    for(uint n=0; n<instance->num_nodes(); ++n)
-      hBackPropagateError(instance->node(n));
+    for(Instance* const* it=first; it!=last; ++it) {
+      NodeActivations<T>* na = _activations.nodes(*it);
+      for(uint n=0; n<(*it)->num_nodes(); ++n)
+	hBackPropagateError((*it)->node(n), na[n]);
+    }
 
   if(_ss_tr)
-    gBackPropagateError(instance);
+    gBackPropagateError(first, last);
   
-  for(int i=0; i<_norient; ++i)
-    backPropOnFoldingPart(instance, i);
+  bool packed = _packed && _schedule == LEVEL_SCHEDULE;
+  if(packed)
+    packSequences(first, last);
+
+  bool concurrent = concurrentOrientations();
+  const int nthreads = concurrent?std::max(1, _nthreads/_norient):_nthreads;
+
+  _pool.run(_norient, concurrent?_norient:1, [&](int i) {
+      if(packed)
+	backPropSequencesOnFoldingPart(i);
+      else if(_schedule == LEVEL_SCHEDULE)
+	backPropLevelsOnFoldingPart(first, last, i, nthreads);
+      else
+	for(Instance* const* it=first; it!=last; ++it)
+	  backPropOnFoldingPart(*it, i);
+    });
+
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::accumulateGradient(DataSet::const_iterator first, DataSet::const_iterator last) {
+  if(first == last)
+    return;
+
+  Instance* const* instances = &*first;
+  const int ninstances = last - first;
+  if(_parallel_training != SYNCHRONOUS_TRAINING || _nthreads < 2) {
+    propagateInstances(instances, instances + ninstances);
+    backPropagateInstances(instances, instances + ninstances);
+    return;
+  }
+
+  // Each worker takes a contiguous share of the instances,
+  // which it processes as a single batch
+  const int nworkers = std::min(_nthreads, ninstances);
+  worker(nworkers-1); // create the missing workers
+
+  _pool.run(nworkers, nworkers, [&](int t) {
+      Instance* const* b = instances + t*ninstances/nworkers;
+      Instance* const* e = instances + (t+1)*ninstances/nworkers;
+
+      _workers[t]->shareWeights(this);
+      _workers[t]->propagateInstances(b, e);
+      _workers[t]->backPropagateInstances(b, e);
+    });
+
+  reduceGradients(nworkers);
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  RecursiveNN<HA_Function, OA_Function, EMP, T, G>* RecursiveNN<HA_Function, OA_Function, EMP, T, G>::worker(int t) {
+  // workers are created on demand and kept for the following calls
+  while((int)_workers.size() <= t)
+    _workers.push_back(new RecursiveNN(this));
+
+  return _workers[t];
+}
 
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::trainOnline(DataSet::const_iterator first, DataSet::const_iterator last,
+								    float learning_rate, float momentum_term, float ni) {
+  const int ninstances = last - first;
+  if(_parallel_training != ASYNCHRONOUS_TRAINING || _nthreads < 2 || ninstances < 2) {
+    for(DataSet::const_iterator it=first; it!=last; ++it) {
+      propagateStructuredInput(*it);
+      backPropagateError(*it);
+      adjustWeights(learning_rate, momentum_term, ni);
+    }
+    return;
+  }
+
+  require(0<=learning_rate && learning_rate<=1, "Learning rate interval assertion failed");
+  require(0<=momentum_term && momentum_term<1, "Learning rate interval assertion failed");
+  require(0<=ni && ni<1, "Regularization coeff. interval assertion failed");
+  require(!_rollback, "Cannot rollback asynchronous updates");
+
+  // The workers apply the rule of MGradientDescent, which is also
+  // that of GradientDescent without momentum and weight decay
+  const bool plain = std::is_same<EMP<T, G>, GradientDescent<T, G> >::value;
+  require(plain || std::is_same<EMP<T, G>, MGradientDescent<T, G> >::value,
+	  "Asynchronous training requires the GD or MOMENTUM optimizer");
+  if(plain)
+    momentum_term = ni = .0;
+
+  // Each worker takes a contiguous share of the instances and
+  // updates the weights after each of them, without waiting
+  // for the others
+  Instance* const* instances = &*first;
+  const int nworkers = std::min(_nthreads, ninstances);
+  worker(nworkers-1); // create the missing workers
+
+  _pool.run(nworkers, nworkers, [&](int t) {
+      RecursiveNN* w = _workers[t];
+      w->shareWeights(this);
+      for(int i=t*ninstances/nworkers; i<(t+1)*ninstances/nworkers; ++i) {
+	w->propagateInstances(instances + i, instances + i+1);
+	w->backPropagateInstances(instances + i, instances + i+1);
+	w->updateSharedWeights(this, learning_rate, momentum_term, ni);
+      }
+    });
+
+  transposeFoldingWeights();
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-  void RecursiveNN<HA_Function, OA_Function, EMP>::predict(Instance* instance) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::updateSharedWeights(RecursiveNN* network, float learning_rate, float momentum_term, float ni) {
+  // The update rule of MGradientDescent, applied by a worker to the weights
+  // of its network while the other workers read and update them too. Each
+  // weight is read and written as a whole, an update of another worker
+  // in between may be lost: with sparse enough gradients, this does not
+  // hinder convergence (Hogwild).
+  T* w = network->_w.data();
+  const G* gradient_w = _gradient_w.data();
+  G* old_deltas_w = _momentum_w.data();
+
+  for(size_t p=0; p<_gradient_w.size(); ++p) {
+    const T w_p = relaxed_load(w + p);
+    const G new_delta_w = -learning_rate * gradient_w[p] + momentum_term * old_deltas_w[p] - ni * w_p;
+
+    relaxed_store(w + p, T(w_p + new_delta_w));
+    old_deltas_w[p] = new_delta_w;
+  }
+
+  resetGradientComponents();
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::reduceGradients(int nworkers) {
+  // Sum the gradients of the workers pairwise, as the leaves of a binary
+  // tree, then add the total to the gradient of the network: the order of
+  // the sums only depends on the number of workers. Each thread reduces
+  // its own part of the buffers, resetting those of the workers.
+  const size_t size = _gradient_w.size();
+
+  _pool.run(nworkers, nworkers, [&](int c) {
+      const size_t p0 = c*size/nworkers, p1 = (c+1)*size/nworkers;
+
+      for(int stride=1; stride<nworkers; stride*=2)
+	for(int t=0; t+stride<nworkers; t+=2*stride)
+	  axpy(p1-p0, G(1), _workers[t+stride]->_gradient_w.data() + p0, _workers[t]->_gradient_w.data() + p0);
+      axpy(p1-p0, G(1), _workers[0]->_gradient_w.data() + p0, _gradient_w.data() + p0);
+
+      for(int t=0; t<nworkers; ++t)
+	std::fill(_workers[t]->_gradient_w.data() + p0, _workers[t]->_gradient_w.data() + p1, G(0));
+    });
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::predict(Instance* instance) {
 
   propagateStructuredInput(instance);
   
   if(_ss_tr) {
-    std::vector<float> outputs(_g_layers_activations[_s-1],
-			       _g_layers_activations[_s-1]+_lnunits[_r+_s-1]);
+    std::vector<float> outputs(_g_layers_activations[_s-1].begin(),
+			       _g_layers_activations[_s-1].begin()+_lnunits[_r+_s-1]);
     
     /*
      * apply softmax in case of a multi-class (N>2) classification problem
@@ -1206,10 +1658,10 @@ template<class HA_Function, class OA_Function, class EMP>
   }
   
   if(_ios_tr) {
+    NodeActivations<T>* na = _activations.nodes(instance);
     for(uint n=0; n<instance->num_nodes(); ++n) {
-      Node* node = instance->node(n);
-      std::vector<float> outputs(node->_h_layers_activations[_s-1],
-				 node->_h_layers_activations[_s-1]+_lnunits[_r+_s-1]);
+      std::vector<float> outputs(na[n]._h_layers_activations[_s-1],
+				 na[n]._h_layers_activations[_s-1]+_lnunits[_r+_s-1]);
       
       /*
        * apply softmax in case of a multi-class (N>2) classification problem
@@ -1228,21 +1680,21 @@ template<class HA_Function, class OA_Function, class EMP>
 	  outputs[j] /= norm_factor;
       }
 
-      node->load_output(outputs);
+      instance->node(n)->load_output(outputs);
     }    
   }
   
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-  void RecursiveNN<HA_Function, OA_Function, EMP>::predict(DataSet* dataset) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::predict(DataSet* dataset) {
 
   for(DataSet::iterator it=dataset->begin(); it!=dataset->end(); ++it)
     predict(*it);
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-  double RecursiveNN<HA_Function, OA_Function, EMP>::computeError(Instance* instance) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  double RecursiveNN<HA_Function, OA_Function, EMP, T, G>::computeError(Instance* instance) {
 
   propagateStructuredInput(instance);
   
@@ -1256,12 +1708,10 @@ template<class HA_Function, class OA_Function, class EMP>
   return error;
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-  double RecursiveNN<HA_Function, OA_Function, EMP>::computeError(DataSet* dataset) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  double RecursiveNN<HA_Function, OA_Function, EMP, T, G>::computeError(DataSet* dataset) {
 
-  double error = .0;
-  for(DataSet::iterator it=dataset->begin(); it!=dataset->end(); ++it)
-    error += computeError(*it);
+  double error = sumErrors(dataset, &RecursiveNN::computeError);
 
   if(_ss_tr && _problem & REGRESSION)
     error /= dataset->size();
@@ -1269,318 +1719,529 @@ template<class HA_Function, class OA_Function, class EMP>
   return error;
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-  void RecursiveNN<HA_Function, OA_Function, EMP>::backPropOnFoldingPart(Instance* instance, int o) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  double RecursiveNN<HA_Function, OA_Function, EMP, T, G>::computeLoss(Instance* instance) {
+
+  propagateStructuredInput(instance);
+
+  double loss = .0;
+  if(_ss_tr)
+    loss += computeSSError(instance);
+
+  if(_ios_tr)
+    loss += computeIOSError(instance) * (_problem & REGRESSION?instance->num_nodes():1);
+
+  return _problem & REGRESSION?loss/2:loss;
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  double RecursiveNN<HA_Function, OA_Function, EMP, T, G>::computeLoss(DataSet* dataset) {
+  return sumErrors(dataset, &RecursiveNN::computeLoss);
+}
 
-  DPAG* dpag = instance->orientation(o);
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  double RecursiveNN<HA_Function, OA_Function, EMP, T, G>::sumErrors(DataSet* dataset, double (RecursiveNN::*error_of)(Instance*)) {
+  // sum of the errors of the instances, as given by error_of
 
-  Vertex_d currentNode;
-  //VertexId vertex_id = boost::get(boost::vertex_index, *dpag);
-  EdgeId edge_id = boost::get(boost::edge_index, *dpag);
-  outIter out_i, out_end;
+  double error = .0;
+  const int ninstances = dataset->size();
+  if(_parallel_training != SYNCHRONOUS_TRAINING || _nthreads < 2 || ninstances < 2) {
+    for(DataSet::iterator it=dataset->begin(); it!=dataset->end(); ++it)
+      error += (this->*error_of)(*it);
+  } else {
+    // the workers evaluate their share of the instances,
+    // partial errors are summed in order
+    const int nworkers = std::min(_nthreads, ninstances);
+    worker(nworkers-1); // create the missing workers
+
+    std::vector<double> errors(nworkers, .0);
+    _pool.run(nworkers, nworkers, [&](int t) {
+	_workers[t]->shareWeights(this);
+	for(int i=t*ninstances/nworkers; i<(t+1)*ninstances/nworkers; ++i)
+	  errors[t] += (_workers[t]->*error_of)((*dataset)[i]);
+      });
+    for(int t=0; t<nworkers; ++t)
+      error += errors[t];
+  }
 
-  std::vector<int> top_ord = instance->topological_order(o);
-  for(std::vector<int>::const_iterator it=top_ord.begin(); it!=top_ord.end(); ++it) {
-    int t = *it;
+  return error;
+}
 
-    Node* node = instance->node(t);
-    currentNode = boost::vertex(t, *dpag);
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::backPropOnFoldingPart(Instance* instance, int o) {
+  FoldingWorkspace& ws = _workspaces[o];
+  Instance::OrientationRef orientation;
+  if(!_implicit)
+    orientation = instance->oriented(o);
+  const CSRGraph* graph = orientation?&orientation->graph:0;
+
+  const int ni = _n + _v*_m;
+  ws.inputs.resize(ni);
+  NodeActivations<T>* na = _activations.nodes(instance);
+
+  // Nodes in topological order: for implicit
+  // instances, level by level, highest first
+  const int nn = instance->num_nodes();
+  int l = _implicit?instance->num_levels(o)-1:0;
+  int pos = 0; // of the next node in level l
+
+  for(int n=0; n<nn; ++n) {
+    int t;
+    if(_implicit) {
+      t = instance->level_node(o, l, pos);
+      if(++pos == instance->level_size(o, l)) {
+	--l;
+	pos = 0;
+      }
+    } else
+      t = orientation->order[n];
+    NodeActivations<T>& node = na[t];
 
-    if(_r > 1) {
-      /*
-       * there are hidden layers:
-       * compute their errors using the generalised delta rule
-       */
-      for(int k=_r-2; k>=0; k--) {
+    /*
+     * deltas of the representation layer are stored at the node level:
+     * they've been updated with the errors coming from the node output
+     * network and the contributions coming from the node parents
+     */
+    const T* delta = _activations.delta(node, o);
+
+    for(int k=_r-1; k>=0; k--) {
+      if(k < _r-1) {
 	/*
-	 * start at _r-2 as _r-1 is stored at the node level and has already 
-	 * been updated with the contribution coming from the node output
-	 * network and the deltas coming from the node ancestors
+	 * there are hidden layers:
+	 * compute their errors using the generalised delta rule
 	 */
-	memset(_delta_layers[o][k], 0, (_lnunits[k])*sizeof(double));
-
-	for(int i=0; i<_lnunits[k]; i++) {
-	  double sum = 0.0;
-	  if(k ==_r-2) {
-	    /*
-	     * this is the penultimate layer, delta values of the preceding 
-	     * (representation) layer have been computed and are stored at the node level 
-	     */
-	    for(int j=0; j<_lnunits[k+1]; j++)
-	      sum += _layers_w[o][k+1][i][j] * node->_delta_lr[o][j];
-	    // or sum += _layers_w[o][k+1][i][j] * (node->*ptn_dv)[o][j];
-	  } else
-	    /*
-	     * we're in a hidden layer but there are others ahead
-	     * so take the delta values directly from them
-	     */
-	    for(int j=0; j<_lnunits[k+1]; j++)
-	      sum += _layers_w[o][k+1][i][j] * _delta_layers[o][k+1][j];
-	  
-	  _delta_layers[o][k][i] = derivate(haf, node->_layers_activations[o][k][i]) * sum;
-	}
+	for(int i=0; i<_lnunits[k]; i++)
+	  _delta_layers[o][k][i] =
+	    derivate(haf, node._layers_activations[o][k][i]) * dot(_lnunits[k+1], _layers_w[o][k+1][i], delta);
 
-	/* 
-	 * can now compute the gradient of weights connecting this layer
-	 * to the preceding one
-	 */
-	if(k>0) {
-	  /*
-	   * this is not the last layer (before the input) of the state transition network
-	   * take the activations of the preceding layer from the node
-	   */
-	  for(int j=0; j<_lnunits[k]; j++) {
-	    for(int i=0; i<_lnunits[k-1]; i++)
-	      _layers_gradient_w[o][k][i][j] -= 
-		_delta_layers[o][k][j] * node->_layers_activations[o][k-1][i];
-	    
-	    _layers_gradient_w[o][k][_lnunits[k-1]][j] -= _delta_layers[o][k][j];
-	  }
-	} else {
-	  /*
-	   * this is the layer connected to the input:
-	   * - the current node input
-	   * - the representation of the substructures rooted at the children
-	   */
-	  for(int j=0; j<_lnunits[0]; j++) {
-	    // first consider input label
-	    for(int i=0; i<_n; i++) {
-	      _layers_gradient_w[o][0][i][j] -= 
-		_delta_layers[o][k][j] * node->_encodedInput[i];
-	    }
-	    // then consider ordered children
-	    // eliminate control on max outdegree: ignore edges whose id is greater than max outdegree.
-	    for(boost::tie(out_i, out_end)=out_edges(currentNode, *dpag); 
-		out_i!=out_end && edge_id[*out_i] < (uint)_v; ++out_i) {
-	      //require(0<=edge_id[*out_i] && edge_id[*out_i] < _v, "Valence assertion failed!");
-	      Node* successor = instance->node(target(*out_i, *dpag));
-	      
-	      for(uint i=_n + edge_id[*out_i]*_m; i<_n + _m*(edge_id[*out_i] + 1); i++)
-		_layers_gradient_w[o][0][i][j] -=
-		  _delta_layers[o][k][j] * successor->_layers_activations[o][_r-1][(i-_n)%_m];
-	      
-	    }
-	  }
-	}
+	delta = _delta_layers[o][k];
       }
-    } else {
+
       /*
-       * deltas of current layer are already calculated
-       * and stored at the node level
-       * they've been updated with the errors coming from
-       * from the node output network and the contributions
-       * coming from the node parent
+       * can now compute the gradient of weights connecting this layer
+       * to the preceding one, whose activations are taken from the node or,
+       * for the layer connected to the input, are the current node input
+       * and the representation of the substructures rooted at the children
        */
-      for(int j=0; j<_lnunits[0]; j++) {
-	// first consider input label
-	for(int i=0; i<_n; i++) {
-	  _layers_gradient_w[o][0][i][j] -= 
-	    node->_delta_lr[o][j] * node->_encodedInput[i];
-	}
-	// then consider ordered children
-	// eliminate control on max outdegree: ignore edges whose id is greater than max outdegree.
-	for(boost::tie(out_i, out_end)=out_edges(currentNode, *dpag); 
-	    out_i!=out_end && edge_id[*out_i] < (uint)_v; ++out_i) {
-	  //require(0<=edge_id[*out_i] && edge_id[*out_i] < _v, "Valence assertion failed!");
-	  Node* successor = instance->node(target(*out_i, *dpag));
-	  
-	  for(uint i=_n + edge_id[*out_i]*_m; i<_n + _m*(edge_id[*out_i] + 1); i++)
-	    _layers_gradient_w[o][0][i][j] -=
-	      node->_delta_lr[o][j] * successor->_layers_activations[o][_r-1][(i-_n)%_m];
-
-	}
+      const T* in;
+      int nin;
+      if(k > 0) {
+	in = node._layers_activations[o][k-1];
+	nin = _lnunits[k-1];
+      } else {
+	gatherNodeInputs(instance, graph, na, o, t, &ws.inputs[0]);
+	in = &ws.inputs[0];
+	nin = ni;
       }
+
+      Matrix<G>& gw = _layers_gradient_w[o][k];
+      for(int i=0; i<nin; i++)
+	axpy(_lnunits[k], G(-in[i]), delta, gw[i]);
+      // and finally the threshold unit
+      axpy(_lnunits[k], G(-1), delta, gw[nin]);
     }
 
     /*
      * distribute delta error among representation layers
-     * of immediate successors of current node t
+     * of immediate successors of current node t, the one
+     * at position p being successor s
      */
-    for(boost::tie(out_i, out_end)=out_edges(currentNode, *dpag); 
-	out_i!=out_end && edge_id[*out_i] < (uint)_v; ++out_i) {
-      Node* successor = instance->node(target(*out_i, *dpag));
+    auto distribute = [&](int s, int p) {
+      NodeActivations<T>& successor = na[s];
+      T* successor_delta = _activations.delta(successor, o);
       
-      for(uint i=_n + edge_id[*out_i]*_m; i<_n + _m*(edge_id[*out_i] + 1); i++) {
-	double sum = 0.0;
-	
-	if(_r == 1)
-	  /*
-	   * one layer in the state transition function
-	   * its delta values are stored at the node level and
-	   * represent the errors of the following layer to
-	   * redistribute to the representation layers of the children 
-	   */
-	  for(int j=0; j<_lnunits[0]; j++)
-	    sum += _layers_w[o][0][i][j] * node->_delta_lr[o][j];
-	
-	else
-	  /*
-	   * network has more than one layer hence we take the deltas
-	   * at the last one before the input
-	   */
-	  for(int j=0; j<_lnunits[0]; j++)
-	    sum += _layers_w[o][0][i][j] * _delta_layers[o][0][j];
-
-	/* 
-	 * delta values for the representation layer of a node t
-	 * coming from different immediate predecessors have to be
-	 * summed up, before they are propagated deeper into the 
-	 * folding part of t and of its successors
-	 */
-	successor->_delta_lr[o][(i-_n)%_m] +=
-	  derivate(haf, successor->_layers_activations[o][_r-1][(i-_n)%_m]) * sum;
-      }
+      /* 
+       * delta values for the representation layer of a node t
+       * coming from different immediate predecessors have to be
+       * summed up, before they are propagated deeper into the 
+       * folding part of t and of its successors
+       */
+      for(int i=0; i<_m; i++)
+	successor_delta[i] +=
+	  derivate(haf, successor._layers_activations[o][_r-1][i]) *
+	  dot(_lnunits[0], _layers_w[o][0][_n + p*_m + i], delta);
+    };
+
+    if(_implicit) {
+      int children[2];
+      const int nc = std::min(instance->children(o, t, children), _v);
+      for(int c=0; c<nc; ++c)
+	distribute(children[c], c);
+      continue;
+    }
+
+    for(int c=graph->out_begin(t); c<graph->out_end(t); ++c) {
+      // ignore edges whose id is greater than max outdegree
+      if(graph->position(c) >= _v)
+	continue;
+
+      distribute(graph->target(c), graph->position(c));
     }
   }
 
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-  void RecursiveNN<HA_Function, OA_Function, EMP>::gBackPropagateError(Instance* instance) {
-  
-  int k = _s-1;
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::backPropLevelsOnFoldingPart(Instance* const* first, Instance* const* last, int o, int nthreads) {
+  FoldingWorkspace& ws = _workspaces[o];
+  // Mirror the forward level schedule: process levels in reverse order,
+  // so that the deltas at the representation layer of the nodes in a level
+  // have been accumulated from all of their parents.
+  holdOrientations(first, last, o);
+  const uint nlevels = numLevels(first, last, o);
+
+  for(int l=nlevels-1; l>=0; --l) {
+    const int nb = gatherLevelNodes(first, last, o, l);
+
+    ws.inputs.resize(nb*(_n + _v*_m));
+    ws.errors.resize(nb*_v*_m);
+    for(int k=0; k<_r; k++) {
+      ws.activations[k].resize(nb*_lnunits[k]);
+      ws.deltas[k].resize(nb*_lnunits[k]);
+    }
 
-  std::vector<float> targets = instance->target();
-  std::vector<float> outputs(_g_layers_activations[_s-1],
-			     _g_layers_activations[_s-1]+_lnunits[_r+k]);
-  require(targets.size() == outputs.size(), "output dim. error");
+    // the deltas of each row, then the gradient, whose rows
+    // sum over all the nodes of the level, are split among the threads
+    const int nchunks = numChunks(nb, nthreads);
+    ws.pool.run(nchunks, nthreads, [&](int c) {
+	backPropLevelRows(o, c*nb/nchunks, (c+1)*nb/nchunks);
+      });
+    ws.pool.run(nchunks, nthreads, [&](int c) {
+	levelGradientRows(o, nb, c, nchunks);
+      });
+
+    /*
+     * distribute delta error among representation layers
+     * of immediate successors of the nodes in the level:
+     * nodes may share children, this is done sequentially
+     */
+    for(int b=0; b<nb; ++b) {
+      Instance* instance = ws.nodes[b].first;
+      NodeActivations<T>* na = ws.buffers[b];
+      const T* errors = &ws.errors[b*_v*_m];
+
+      if(_implicit) {
+	int children[2];
+	const int nc = std::min(instance->children(o, ws.nodes[b].second, children), _v);
+	for(int c=0; c<nc; ++c) {
+	  NodeActivations<T>& successor = na[children[c]];
+	  T* successor_delta = _activations.delta(successor, o);
+	  const T* e = errors + c*_m;
+	  for(int i=0; i<_m; i++)
+	    successor_delta[i] +=
+	      derivate(haf, successor._layers_activations[o][_r-1][i]) * e[i];
+	}
+	continue;
+      }
+
+      const CSRGraph& graph = *ws.graphs[b];
+      const int t = ws.nodes[b].second;
+
+      for(int c=graph.out_begin(t); c<graph.out_end(t); ++c) {
+	if(graph.position(c) >= _v)
+	  continue;
+
+	NodeActivations<T>& successor = na[graph.target(c)];
+	T* successor_delta = _activations.delta(successor, o);
+	const T* e = errors + graph.position(c)*_m;
+	for(int i=0; i<_m; i++)
+	  successor_delta[i] +=
+	    derivate(haf, successor._layers_activations[o][_r-1][i]) * e[i];
+      }
+    }
+  }
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::backPropLevelRows(int o, int b0, int b1) {
+  FoldingWorkspace& ws = _workspaces[o];
+  const int nb = b1 - b0;
+  const int ni = _n + _v*_m;
 
   /*
-   * apply softmax in case of a multi-class (N>2) classification problem
+   * gather activations of each layer and deltas at the representation
+   * layer, already updated with the errors coming from the node output
+   * network and the contributions coming from the node parents
    */
-  if(_problem & MULTICLASS) {
-    float max = -FLT_MAX;
-    for(uint i=0; i<outputs.size(); ++i)
-      if(max < outputs[i]) max = outputs[i];
-      
-    float norm_factor = 0.0;
-    for(uint j=0; j<outputs.size(); ++j) {
-      outputs[j] = exp(outputs[j] - max);
-      norm_factor += outputs[j];
+  for(int b=b0; b<b1; ++b) {
+    NodeActivations<T>& node = ws.buffers[b][ws.nodes[b].second];
+    for(int k=0; k<_r; k++) {
+      const T* a = node._layers_activations[o][k];
+      std::copy(a, a + _lnunits[k], &ws.activations[k][b*_lnunits[k]]);
     }
-    for(uint j=0; j<outputs.size(); ++j)
-      outputs[j] /= norm_factor;
+    const T* d = _activations.delta(node, o);
+    std::copy(d, d + _m, &ws.deltas[_r-1][b*_m]);
   }
 
   /*
-   * compute errors at the output layer and gradient of
-   * the weights from the previous to the output layer
+   * compute the errors of the hidden layers
+   * using the generalised delta rule
    */
-  memset(_delta_g_layers[k], 0, (_lnunits[_r+k])*sizeof(double));
+  for(int k=_r-2; k>=0; k--) {
+    T* d = &ws.deltas[k][b0*_lnunits[k]];
+    const T* a = &ws.activations[k][b0*_lnunits[k]];
+    Matrix<T>& w = _layers_w[o][k+1];
+      
+    std::fill(d, d + nb*_lnunits[k], T(0));
+    gemm_nt(nb, _lnunits[k], _lnunits[k+1], T(1),
+	    &ws.deltas[k+1][b0*_lnunits[k+1]], _lnunits[k+1], w.data(), w.stride(), d, _lnunits[k]);
+    for(int p=0; p<nb*_lnunits[k]; ++p)
+      d[p] = derivate(haf, a[p]) * d[p];
+  }
 
-  for(int j=0; j<_lnunits[_r+k]; j++) {
-    _delta_g_layers[k][j] =
-      (_problem & ~(BINARYCLASS | MULTICLASS)?derivate(oaf, outputs[j]):1.0) *
-      (targets[j] - outputs[j]);
-        
-    if(k>0) {
-      /*
-       * super-source network has hidden layers:
-       * gradient at output units depends on delta and 
-       * activation at previous (hidden) layer
-       */
-      for(int i=0; i<_lnunits[_r+k-1]; i++)
-	_g_layers_gradient_w[k][i][j] -= 
-	  _delta_g_layers[k][j] * _g_layers_activations[k-1][i];
+  /*
+   * the inputs of the first layer, i.e. the node input and the representations
+   * of the children, and the errors to redistribute to the children
+   */
+  for(int b=b0; b<b1; ++b)
+    gatherNodeInputs(ws.nodes[b].first, ws.graphs[b], ws.buffers[b], o, ws.nodes[b].second, &ws.inputs[b*ni]);
+
+  Matrix<T>& w = _layers_w[o][0];
+  T* e = &ws.errors[b0*_v*_m];
+  std::fill(e, e + nb*_v*_m, T(0));
+  gemm_nt(nb, _v*_m, _lnunits[0], T(1),
+	  &ws.deltas[0][b0*_lnunits[0]], _lnunits[0], w[_n], w.stride(), e, _v*_m);
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::levelGradientRows(int o, int nb, int c, int nchunks) {
+  FoldingWorkspace& ws = _workspaces[o];
+  /*
+   * gradient of the weights of each layer, summed up over the nodes of the level:
+   * the inputs of the first layer are the node input and the representations of
+   * the children, those of the other layers the activations of the previous one.
+   * Only the c-th of nchunks blocks of the rows of each matrix, threshold last.
+   */
+  for(int k=0; k<_r; k++) {
+    const T* in = k?&ws.activations[k-1][0]:&ws.inputs[0];
+    const int nin = k?_lnunits[k-1]:_n + _v*_m;
+    const T* d = &ws.deltas[k][0];
+    Matrix<G>& gw = _layers_gradient_w[o][k];
+
+    const int i0 = c*(nin+1)/nchunks, i1 = std::min((c+1)*(nin+1)/nchunks, nin);
+    if(i1 > i0)
+      gemm_tn(i1-i0, _lnunits[k], nb, G(-1), in+i0, nin, d, _lnunits[k], gw[i0], gw.stride());
+    if(c == nchunks-1)
+      for(int b=0; b<nb; ++b)
+	for(int j=0; j<_lnunits[k]; j++)
+	  gw[nin][j] -= d[b*_lnunits[k] + j];
+  }
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::backPropSequencesOnFoldingPart(int o) {
+  FoldingWorkspace& ws = _workspaces[o];
+  // Mirror the forward pass: time steps in reverse order, the sequences
+  // active at a step are a prefix of those active at the previous one,
+  // rows at the previous step are those of the children.
+  const int nsteps = _sequences.empty()?0:_sequences[0].length;
+  const int ni = _n + _v*_m;
+  const int nc = _v>0?_m:0; // only the first child position is used
+  int nb = 0;
+
+  std::vector<Node*> nodes;
+  std::vector<NodeActivations<T>*> buffers;
+  for(int s=nsteps-1; s>=0; --s) {
+    // sequences with at least s+1 elements
+    while(nb < (int)_sequences.size() && _sequences[nb].length > s)
+      ++nb;
+
+    nodes.resize(nb);
+    buffers.resize(nb);
+    for(int b=0; b<nb; ++b) {
+      nodes[b] = _sequences[b].instance->node(sequenceNode(_sequences[b], o, s));
+      buffers[b] = &_sequences[b].nodes[sequenceNode(_sequences[b], o, s)];
+    }
+
+    /*
+     * gather activations of each layer and deltas at the representation
+     * layer, already updated with the errors coming from the node output
+     * network and the contributions coming from the next time step
+     */
+    for(int k=0; k<_r; k++) {
+      ws.activations[k].resize(nb*_lnunits[k]);
+      for(int b=0; b<nb; ++b) {
+	const T* a = buffers[b]->_layers_activations[o][k];
+	std::copy(a, a + _lnunits[k], &ws.activations[k][b*_lnunits[k]]);
+      }
+    }
+    ws.deltas[_r-1].resize(nb*_m);
+    for(int b=0; b<nb; ++b) {
+      const T* d = _activations.delta(*buffers[b], o);
+      std::copy(d, d + _m, &ws.deltas[_r-1][b*_m]);
+    }
+
+    /*
+     * compute the errors of the hidden layers
+     * using the generalised delta rule
+     */
+    for(int k=_r-2; k>=0; k--) {
+      std::vector<T>& d = ws.deltas[k];
+      Matrix<T>& w = _layers_w[o][k+1];
       
-      _g_layers_gradient_w[k][_lnunits[_r+k-1]][j] -= // bias
-	_delta_g_layers[k][j];
+      d.assign(nb*_lnunits[k], T(0));
+      gemm_nt(nb, _lnunits[k], _lnunits[k+1], T(1),
+	      &ws.deltas[k+1][0], _lnunits[k+1], w.data(), w.stride(), &d[0], _lnunits[k]);
+      for(int p=0; p<nb*_lnunits[k]; ++p)
+	d[p] = derivate(haf, ws.activations[k][p]) * d[p];
+    }
 
-    } else {
-      /*
-       * super-source network has just one output layer:
-       * activations to compute the gradient come from the activation of the output units
-       * of the different state transition networks of the root nodes in each orientation
-       */
-      for(int o=0; o<_norient; ++o) {
-	// the first node in the topological order of each orientation
-	// is a super-source node which contributes to the activation
-	// of the units of the MLP implementing the super-source transduction
-	Node* node = instance->node((instance->topological_orders())[o][0]);
-	for(int i=o*_m; i<(o+1)*_m; ++i)
-	  _g_layers_gradient_w[0][i][j] -=
-	    _delta_g_layers[k][j] * node->_layers_activations[o][_r-1][i-o*_m];
+    /*
+     * gradient of the weights of each layer, summed up over the sequences:
+     * the inputs of the first layer are the node label and the representation
+     * at the previous step, those of the other layers the activations of the
+     * previous one
+     */
+    ws.inputs.assign(nb*(_n+nc), T(0));
+    for(int b=0; b<nb; ++b) {
+      T* x = &ws.inputs[b*(_n+nc)];
+      std::copy(nodes[b]->input_data(), nodes[b]->input_data() + nodes[b]->input_dim(), x);
+      if(s > 0 && nc) {
+	const T* rep = _sequences[b].nodes[sequenceNode(_sequences[b], o, s-1)]._layers_activations[o][_r-1];
+	std::copy(rep, rep + _m, x + _n);
       }
+    }
+    
+    for(int k=0; k<_r; k++) {
+      const T* in = k?&ws.activations[k-1][0]:&ws.inputs[0];
+      const int nin = k?_lnunits[k-1]:_n+nc;
+      const T* d = &ws.deltas[k][0];
+      Matrix<G>& gw = _layers_gradient_w[o][k];
+
+      gemm_tn(nin, _lnunits[k], nb, G(-1), in, nin, d, _lnunits[k], gw.data(), gw.stride());
+      G* threshold = gw[k?nin:ni];
+      for(int b=0; b<nb; ++b)
+	for(int j=0; j<_lnunits[k]; j++)
+	  threshold[j] -= d[b*_lnunits[k] + j];
+    }
 
-      _g_layers_gradient_w[0][_norient*_m][j] -= _delta_g_layers[k][j];
+    /*
+     * distribute delta error among representation layers
+     * of the elements at the previous step
+     */
+    if(s == 0 || !nc)
+      continue;
+    
+    Matrix<T>& w = _layers_w[o][0];
+    ws.errors.assign(nb*_m, T(0));
+    gemm_nt(nb, _m, _lnunits[0], T(1),
+	    &ws.deltas[0][0], _lnunits[0], w[_n], w.stride(), &ws.errors[0], _m);
+    
+    for(int b=0; b<nb; ++b) {
+      NodeActivations<T>& child = _sequences[b].nodes[sequenceNode(_sequences[b], o, s-1)];
+      T* child_delta = _activations.delta(child, o);
+      const T* e = &ws.errors[b*_m];
+      for(int i=0; i<_m; i++)
+	child_delta[i] +=
+	  derivate(haf, child._layers_activations[o][_r-1][i]) * e[i];
     }
   }
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::gBackPropagateError(Instance* const* first, Instance* const* last) {
+  const int nb = last-first;
+  const int ni = _norient*_m;
+  int k = _s-1;
 
   /*
-   * backpropagate error and compute gradient of the weights in the previous layers
+   * compute errors at the output layer for each instance
    */
-  for(--k; k>=0; k--) {
-    memset(_delta_g_layers[k], 0, (_lnunits[_r+k])*sizeof(double));
+  int nu = _lnunits[_r+k];
+  _delta_g_layers[k].assign(nb*nu, T(0));
 
-    for(int i=0; i<_lnunits[_r+k]; i++) {
-      double sum = 0.0;
-      for(int j=0; j<_lnunits[_r+k+1]; j++) {
-	sum += _g_layers_w[k+1][i][j] * _delta_g_layers[k+1][j];
+  for(int b=0; b<nb; ++b) {
+    std::vector<float> targets = first[b]->target();
+    std::vector<float> outputs(_g_layers_activations[k].begin() + b*nu,
+			       _g_layers_activations[k].begin() + (b+1)*nu);
+    require(targets.size() == outputs.size(), "output dim. error");
+
+    /*
+     * apply softmax in case of a multi-class (N>2) classification problem
+     */
+    if(_problem & MULTICLASS) {
+      float max = -FLT_MAX;
+      for(uint i=0; i<outputs.size(); ++i)
+	if(max < outputs[i]) max = outputs[i];
+      
+      float norm_factor = 0.0;
+      for(uint j=0; j<outputs.size(); ++j) {
+	outputs[j] = exp(outputs[j] - max);
+	norm_factor += outputs[j];
       }
-      _delta_g_layers[k][i] = 
-	derivate(haf, _g_layers_activations[k][i]) * sum;
+      for(uint j=0; j<outputs.size(); ++j)
+	outputs[j] /= norm_factor;
     }
 
-    if(k>0) {
-      /*
-       * this is a hidden layer but there are more:
-       * the activations for the delta rule come from
-       * the activations of the units from the previous layer
-       */
-      for(int j=0; j<_lnunits[_r+k]; j++) {
-	for(int i=0; i<_lnunits[_r+k-1]; i++)
-	  _g_layers_gradient_w[k][i][j] -= 
-	    _delta_g_layers[k][j] * _g_layers_activations[k-1][i];
+    for(int j=0; j<nu; j++)
+      _delta_g_layers[k][b*nu + j] =
+	(_problem & ~(BINARYCLASS | MULTICLASS)?derivate(oaf, T(outputs[j])):1.0) *
+	(targets[j] - outputs[j]);
+  }
 
-	_g_layers_gradient_w[k][_lnunits[_r+k-1]][j] -=  _delta_g_layers[k][j];
-      }
-    } else {
-      /*
-       * this is the last hidden layer before the inputs whose activations come 
-       * from the output unit values of the different state transition networks 
-       * at the root nodes of each orientation
-       */
-      for(int j=0; j<_lnunits[_r+k]; j++) {
-	for(int o=0; o<_norient; ++o) {
-	  Node* node = instance->node((instance->topological_orders())[o][0]);
-	  for(int i=o*_m; i<(o+1)*_m; ++i)
-	    _g_layers_gradient_w[0][i][j] -=
-	      _delta_g_layers[k][j] * node->_layers_activations[o][_r-1][i-o*_m];
-	}
-	
-	_g_layers_gradient_w[0][_norient*_m][j] -= _delta_g_layers[k][j];
+  /*
+   * backpropagate error and compute gradient of the weights of each layer,
+   * summed up over the instances: the activations for the delta rule come
+   * from the units of the previous layer or, for the first layer, from the
+   * output units of the different state transition networks at the root
+   * nodes of each orientation
+   */
+  gatherSuperSources(first, last);
 
-      }
+  for(; k>=0; k--) {
+    nu = _lnunits[_r+k];
+    std::vector<T>& d = _delta_g_layers[k];
+
+    if(k < _s-1) {
+      Matrix<T>& w = _g_layers_w[k+1];
+
+      d.assign(nb*nu, T(0));
+      gemm_nt(nb, nu, _lnunits[_r+k+1], T(1),
+	      &_delta_g_layers[k+1][0], _lnunits[_r+k+1], w.data(), w.stride(), &d[0], nu);
+      for(int p=0; p<nb*nu; ++p)
+	d[p] = derivate(haf, _g_layers_activations[k][p]) * d[p];
     }
+
+    const T* in = k?&_g_layers_activations[k-1][0]:&_g_inputs[0];
+    const int nin = k?_lnunits[_r+k-1]:ni;
+    Matrix<G>& gw = _g_layers_gradient_w[k];
+
+    gemm_tn(nin, nu, nb, G(-1), in, nin, &d[0], nu, gw.data(), gw.stride());
+    for(int b=0; b<nb; ++b)
+      for(int j=0; j<nu; j++)
+	gw[nin][j] -= d[b*nu + j]; // bias
   }
 
   /*
    * calculate the error on input layer and redistribute on the 
    * representation layers of the root nodes of each orientation
    */
-  for(int o=0; o<_norient; ++o) {
-    Node* n = instance->node((instance->topological_orders())[o][0]);
+  Matrix<T>& w = _g_layers_w[0];
+  _g_errors.assign(nb*ni, T(0));
+  gemm_nt(nb, ni, _lnunits[_r], T(1),
+	  &_delta_g_layers[0][0], _lnunits[_r], w.data(), w.stride(), &_g_errors[0], ni);
+
+  for(int b=0; b<nb; ++b)
+    for(int o=0; o<_norient; ++o) {
+      NodeActivations<T>& root = _activations.nodes(first[b])[first[b]->root(o)];
+      T* root_delta = _activations.delta(root, o);
+      const T* e = &_g_errors[b*ni + o*_m];
     
-    for(int i=0; i<_m; i++) {
-      double sum = 0.0;
-      for(int j=0; j<_lnunits[_r]; j++)
-	sum += _g_layers_w[0][o*_m + i][j] * _delta_g_layers[0][j];
-      
-      n->_delta_lr[o][i] += 
-	derivate(haf, n->_layers_activations[o][_r-1][i]) * sum;
-    }    
-  }
+      for(int i=0; i<_m; i++)
+	root_delta[i] += 
+	  derivate(haf, root._layers_activations[o][_r-1][i]) * e[i];
+    }
 
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::hBackPropagateError(Node* n) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::hBackPropagateError(Node* n, NodeActivations<T>& na) {
 
   int k = _s-1;
 
   std::vector<float> targets = n->target();
-  std::vector<float> outputs(n->_h_layers_activations[_s-1],
-			     n->_h_layers_activations[_s-1]+_lnunits[_r+k]);
+  std::vector<float> outputs(na._h_layers_activations[_s-1],
+			     na._h_layers_activations[_s-1]+_lnunits[_r+k]);
   require(targets.size() == outputs.size(), "output dim. error");
 
   /*
@@ -1601,97 +2262,37 @@ void RecursiveNN<HA_Function, OA_Function, EMP>::hBackPropagateError(Node* n) {
   }
 
   /*
-   * compute errors at the output layer and gradient of
-   * the weights from the previous to the output layer
+   * compute errors at the output layer
    */
-  memset(_delta_h_layers[k], 0, (_lnunits[_r+k])*sizeof(double));
-  
-  for(int j=0; j<_lnunits[_r+k]; ++j) {
+  for(int j=0; j<_lnunits[_r+k]; ++j)
     _delta_h_layers[k][j] =
-      (_problem & ~(BINARYCLASS | MULTICLASS)?derivate(oaf, outputs[j]):1.0) *
+      (_problem & ~(BINARYCLASS | MULTICLASS)?derivate(oaf, T(outputs[j])):1.0) *
       (targets[j] - outputs[j]);
-      
-    if(k>0) {
-      /*
-       * node output network has hidden layers:
-       * gradient at output units depends on delta and 
-       * activation at previous (hidden) layer
-       */
-      for(int i=0; i<_lnunits[_r+k-1]; i++)
-	_h_layers_gradient_w[k][i][j] -= 
-	  _delta_h_layers[k][j] * n->_h_layers_activations[k-1][i];
-
-      _h_layers_gradient_w[k][_lnunits[_r+k-1]][j] -= 
-	_delta_h_layers[k][j];
-
-    } else {
-      /*
-       * node output network has just one output layer:
-       * activations to compute the gradient come from the activation of the output units
-       * of the different state transition networks at the node and from its input
-       */
-      for(int o=0; o<_norient; ++o) {
-	for(int i=o*_m; i<(o+1)*_m; ++i)
-	   _h_layers_gradient_w[0][i][j] -=
-	     _delta_h_layers[k][j] * n->_layers_activations[o][_r-1][i-o*_m];
-      }
-      
-      for(int i=_norient*_m; i<_norient*_m + _n; i++)
-	_h_layers_gradient_w[0][i][j] -=
-	   _delta_h_layers[k][j] * n->_encodedInput[i-_norient*_m];
-
-      _h_layers_gradient_w[0][_norient*_m+_n][j] -= _delta_h_layers[k][j];
-    }
-  }
 
   /*
-   * backpropagate error and compute gradient of the weights in the previous layers
+   * backpropagate error and compute gradient of the weights of each layer:
+   * the activations for the delta rule come from the node unit activations
+   * from the previous layer or, for the first one, from the output units
+   * of the different state transition networks and from the node input
    */
-  for(--k; k>=0; k--) {
-    memset(_delta_h_layers[k], 0, (_lnunits[_r+k])*sizeof(double));
+  gatherOutputInputs(n, na);
 
-    for(int i=0; i<_lnunits[_r+k]; i++) {
-      double sum = 0.0;
-      for(int j=0; j<_lnunits[_r+k+1]; j++) {
-	sum += _h_layers_w[k+1][i][j] * _delta_h_layers[k+1][j];
-      }
-      _delta_h_layers[k][i] = 
-	derivate(haf, n->_h_layers_activations[k][i]) * sum;
-    }
+  for(; k>=0; k--) {
+    const int nu = _lnunits[_r+k];
 
-    if(k>0) {
-      /*
-       * this is a hidden layer but there are more:
-       * the activations for the delta rule come from
-       * the node unit activations from the previous layer
-       */
-      for(int j=0; j<_lnunits[_r+k]; j++) {
-	for(int i=0; i<_lnunits[_r+k-1]; i++) {
-	  _h_layers_gradient_w[k][i][j] -= 
-	    _delta_h_layers[k][j] * n->_h_layers_activations[k-1][i];
-	}
-	_h_layers_gradient_w[k][_lnunits[_r+k-1]][j] -=  _delta_h_layers[k][j];
-      }
-    } else {
-      /*
-       * this is the last hidden layer before the inputs whose activations come 
-       * from the output units of the different state transition networks and 
-       * from the node input
-       */
-      for(int j=0; j<_lnunits[_r+k]; j++) {
-	for(int o=0; o<_norient; ++o) {
-	  for(int i=o*_m; i<(o+1)*_m; ++i)
-	    _h_layers_gradient_w[0][i][j] -=
-	      _delta_h_layers[k][j] * n->_layers_activations[o][_r-1][i-o*_m];
-	}
-      
-	for(int i=_norient*_m; i<_norient*_m + _n; i++)
-	  _h_layers_gradient_w[0][i][j] -=
-	    _delta_h_layers[k][j] * n->_encodedInput[i-_norient*_m];
+    if(k < _s-1)
+      for(int i=0; i<nu; i++)
+	_delta_h_layers[k][i] =
+	  derivate(haf, na._h_layers_activations[k][i]) *
+	  dot(_lnunits[_r+k+1], _h_layers_w[k+1][i], _delta_h_layers[k+1]);
 
-	_h_layers_gradient_w[0][_norient*_m+_n][j] -= _delta_h_layers[k][j];
-      }
-    }
+    const T* in = k?na._h_layers_activations[k-1]:&_h_inputs[0];
+    const int nin = k?_lnunits[_r+k-1]:_norient*_m + _n;
+    Matrix<G>& gw = _h_layers_gradient_w[k];
+
+    for(int i=0; i<nin; i++)
+      axpy(nu, G(-in[i]), _delta_h_layers[k], gw[i]);
+    axpy(nu, G(-1), _delta_h_layers[k], gw[nin]); // bias
   }
 
   /*
@@ -1699,29 +2300,24 @@ void RecursiveNN<HA_Function, OA_Function, EMP>::hBackPropagateError(Node* n) {
    * redistribute on representation layers of current node.
    */
   for(int o=0; o<_norient; ++o) {
-    for(int i=0; i<_m; i++) {
-      // could probably optimise a little by removing the outer loop
-      // and calculating the sums over all possible orientation together
-      double sum = 0.0;
-      for(int j=0; j<_lnunits[_r]; j++)
-	sum += _h_layers_w[0][o*_m + i][j] * _delta_h_layers[0][j];
-      
-      n->_delta_lr[o][i] += 
-	derivate(haf, n->_layers_activations[o][_r-1][i]) * sum;
-    }    
+    T* delta = _activations.delta(na, o);
+    for(int i=0; i<_m; i++)
+      delta[i] += 
+	derivate(haf, na._layers_activations[o][_r-1][i]) *
+	dot(_lnunits[_r], _h_layers_w[0][o*_m + i], _delta_h_layers[0]);
   }
 
 }
 
 
 // Compute Error for a structure in case of Super-Source trasduction
-template<class HA_Function, class OA_Function, class EMP>
-  double RecursiveNN<HA_Function, OA_Function, EMP>::computeSSError(Instance* instance) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  double RecursiveNN<HA_Function, OA_Function, EMP, T, G>::computeSSError(Instance* instance) {
   // Assume calling training procedure has just 
   // propagated current pattern with target 'targets'.
   std::vector<float> targets = instance->target();
-  std::vector<float> outputs(_g_layers_activations[_s-1],
-			     _g_layers_activations[_s-1]+_lnunits[_r+_s-1]);
+  std::vector<float> outputs(_g_layers_activations[_s-1].begin(),
+			     _g_layers_activations[_s-1].begin()+_lnunits[_r+_s-1]);
   require(targets.size() == outputs.size(), "output dim. error");
 
   /*
@@ -1763,16 +2359,15 @@ template<class HA_Function, class OA_Function, class EMP>
 }
 
 // Compute Error for a structure in case of IO-Isomorph structural trasduction
-template<class HA_Function, class OA_Function, class EMP>
-  double RecursiveNN<HA_Function, OA_Function, EMP>::computeIOSError(Instance* instance) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+  double RecursiveNN<HA_Function, OA_Function, EMP, T, G>::computeIOSError(Instance* instance) {
 
   double error = .0;
+  NodeActivations<T>* na = _activations.nodes(instance);
   for(uint n=0; n<instance->num_nodes(); ++n) {
-    Node* node = instance->node(n);
-
-    std::vector<float> targets = node->target();
-    std::vector<float> outputs(node->_h_layers_activations[_s-1],
-			       node->_h_layers_activations[_s-1]+_lnunits[_r+_s-1]);
+    std::vector<float> targets = instance->node(n)->target();
+    std::vector<float> outputs(na[n]._h_layers_activations[_s-1],
+			       na[n]._h_layers_activations[_s-1]+_lnunits[_r+_s-1]);
     require(targets.size() == outputs.size(), "output dim. error");
 
     /*
@@ -1816,51 +2411,23 @@ template<class HA_Function, class OA_Function, class EMP>
   return error;
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-double RecursiveNN<HA_Function, OA_Function, EMP>::computeWeightsNorm() {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+double RecursiveNN<HA_Function, OA_Function, EMP, T, G>::computeWeightsNorm() {
+  // weights of the state transition networks and of the output
+  // function are stored contiguously, padding entries are zero
+  const T* w = _w.data();
+  
   double norm = .0;
-
-  if(_ss_tr) { // begin with layers of the MLP output function
-    for(int i=0; i<_norient*_m + 1; ++i)
-      for(int j=0; j<_lnunits[_r]; ++j)
-	norm += _g_layers_w[0][i][j] * _g_layers_w[0][i][j];
-
-    for(int k=1; k<_s; ++k)
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++)
-	for(int j=0; j<_lnunits[_r+k]; j++)
-	  norm += _g_layers_w[k][i][j] * _g_layers_w[k][i][j];
-  }
-
-  if(_ios_tr) { // proceed with layers of the MLP h map
-    for(int i=0; i<_norient*_m + _n + 1; ++i)
-      for(int j=0; j<_lnunits[_r]; ++j)
-	norm += _h_layers_w[0][i][j] * _h_layers_w[0][i][j];
-
-    for(int k=1; k<_s; ++k)
-      for(int i=0; i<_lnunits[_r+k-1]+1; ++i)
-	for(int j=0; j<_lnunits[_r+k]; ++j) 
-	  norm += _h_layers_w[k][i][j] * _h_layers_w[k][i][j];
-  }
-
-  // proceed with state transition networks of the various orientations
-  for(int o=0; o<_norient; ++o) {
-    for(int i=0; i<(_n+_v*_m) + 1; ++i)
-      for(int j=0; j<_lnunits[0]; ++j)
-	norm += _layers_w[o][0][i][j] * _layers_w[o][0][i][j];
-
-    for(int k=1; k<_r; ++k)
-      for(int i=0; i<_lnunits[k-1]+1; ++i)
-	for(int j=0; j<_lnunits[k]; ++j)
-	  norm += _layers_w[o][k][i][j] * _layers_w[o][k][i][j];
-  }
+  for(size_t p=0; p<_w.size(); ++p)
+    norm += w[p] * w[p];
   
   return norm;
 }
 
 
 // Evaluate error and performance of the net over a data set
-/* template<class HA_Function, class OA_Function, class EMP> */
-/* float RecursiveNN<HA_Function, OA_Function, EMP>:: */
+/* template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G> */
+/* float RecursiveNN<HA_Function, OA_Function, EMP, T, G>:: */
 /* evaluatePerformanceOnDataSet(DataSet* ds, bool apply_softmax) { */
 /*   float error = 0.0; */
 /*   for(DataSet::iterator it=ds->begin(); it!=ds->end(); ++it) { */
@@ -1874,8 +2441,8 @@ double RecursiveNN<HA_Function, OA_Function, EMP>::computeWeightsNorm() {
 /*   return error; */
 /* } */
 
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::adjustWeights(float learning_rate, float momentum_term, float ni) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::adjustWeights(float learning_rate, float momentum_term, float ni) {
   // An assertion to safely update weights...
   // In future put this control at the level of training procedure.
   require(0<=learning_rate && learning_rate<=1, "Learning rate interval assertion failed");
@@ -1885,45 +2452,47 @@ void RecursiveNN<HA_Function, OA_Function, EMP>::adjustWeights(float learning_ra
   // Call templatized strategy minimization procedure update method.
   // The optimization strategy type decides to use or not learning rate and/or momentum term
   _wu_method.updateWeights(this, learning_rate, momentum_term, ni);
+  if(_rollback) {
+    // new weights have been written in the shadow buffer
+    _w.swap(_shadow_w);
+    bindWeights();
+    _can_rollback = true;
+  }
+  transposeFoldingWeights();
 
   // Finally reset gradient components to restart their computation.
   // This works both for classic gradient descent and stochastic approximations.
   resetGradientComponents();
 }
 
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::restorePrevWeights() {
-  for(int o=0; o<_norient; ++o) {
-    for(int i=0; i<(_n+_v*_m) + 1; i++)
-      memcpy(_layers_w[o][0][i], _prev_layers_w[o][0][i], _lnunits[0] * sizeof(double));
-  
-    for(int k=1; k<_r; k++)
-      for(int i=0; i<_lnunits[k-1]+1; i++)
-	memcpy(_layers_w[o][k][i], _prev_layers_w[o][k][i], (_lnunits[k])*sizeof(double));
-  }
-  
-  if(_ss_tr) {
-    for(int i=0; i<_norient*_m + 1; i++)
-      memcpy(_g_layers_w[0][i], _prev_g_layers_w[0][i], _lnunits[_r] * sizeof(double));
-    
-    for(int k=1; k<_s; k++)
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++)
-	memcpy(_g_layers_w[k][i], _prev_g_layers_w[k][i], (_lnunits[_r+k])*sizeof(double));
-  }
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::enableRollback(bool enable) {
+  if(enable && !_rollback)
+    _shadow_w.allocate(_layout);
+  else if(!enable)
+    _shadow_w.release();
 
-  if(_ios_tr) {
-    for(int i=0; i<_norient*_m + _n + 1; i++)
-      memcpy(_h_layers_w[0][i], _prev_h_layers_w[0][i], _lnunits[_r] * sizeof(double));
-    
-    for(int k=1; k<_s; k++)
-      for(int i=0; i<_lnunits[_r+k-1]+1; i++)
-	memcpy(_h_layers_w[k][i], _prev_h_layers_w[k][i], (_lnunits[_r+k])*sizeof(double));
-  }
+  _rollback = enable;
+  _can_rollback = false;
+}
+
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::rollback() {
+  require(_rollback, "Rollback is not enabled");
+
+  // nothing to restore if no update since last rollback
+  if(!_can_rollback)
+    return;
+  
+  _w.swap(_shadow_w);
+  bindWeights();
+  transposeFoldingWeights();
+  _can_rollback = false;
 }
 
 /*** Save network parameters to file ***/
-template<class HA_Function, class OA_Function, class EMP>
-void RecursiveNN<HA_Function, OA_Function, EMP>::saveParameters(const char* network_filename) {
+template<class HA_Function, class OA_Function, template<typename, typename> class EMP, typename T, typename G>
+void RecursiveNN<HA_Function, OA_Function, EMP, T, G>::saveParameters(const char* network_filename) {
   std::ofstream os(network_filename);
   assure(os, network_filename);
 
@@ -24,6 +24,8 @@
 
 #include "StructuredDomain.h"
 
+#include <cassert>
+
 using namespace std;
 
 int num_orientations(Domain domain) throw(logic_error) {
@@ -39,3 +41,12 @@ int num_orientations(Domain domain) throw(logic_error) {
 
   throw logic_error("Unrecognised domain type");
 }
+
+void grid_direction(int orientation, int& di, int& dj) {
+  static const int rows[] = { 1, -1, 1, -1 };
+  static const int cols[] = { 1, -1, -1, 1 };
+  assert(orientation>=0 && orientation<4);
+
+  di = rows[orientation];
+  dj = cols[orientation];
+}
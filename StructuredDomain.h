@@ -57,12 +57,38 @@ typedef enum Domain {
 // to process an instance in the given domain
 int num_orientations(Domain domain)
   throw(std::logic_error);
+
+// GRID2D: direction of the children of a cell in each orientation
+// (nwse, senw, nesw, swne), along the rows (di) and the columns (dj)
+void grid_direction(int orientation, int& di, int& dj);
   
 typedef enum Transduction {
   SUPER_SOURCE = 0,
   IO_ISOMORPH
 } Transduction;
 
+/*
+  Order in which the nodes of an orientation are processed:
+
+  - NODE_SCHEDULE: one node at a time, in (reverse) topological order
+  - LEVEL_SCHEDULE: the nodes with the same height all at once, as a block
+*/
+typedef enum FoldingSchedule {
+  NODE_SCHEDULE = 0,
+  LEVEL_SCHEDULE
+} FoldingSchedule;
+
+/*
+  How the orientations of the instances go through their folding parts:
+
+  - SEQUENTIAL_ORIENTATIONS: one after the other
+  - CONCURRENT_ORIENTATIONS: each on its own thread, joined before the output networks
+*/
+typedef enum OrientationSchedule {
+  SEQUENTIAL_ORIENTATIONS = 0,
+  CONCURRENT_ORIENTATIONS
+} OrientationSchedule;
+
 /*
  * Types of learning problems on a structured domain
  */
@@ -0,0 +1,90 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+  Convert a data set to the binary format (see BinaryDataSet.h), which
+  is memory-mapped instead of parsed when loaded. The configuration
+  file gives the domain, the transduction and the dimensions, as for
+  training. Instances are converted one at a time.
+
+  Usage: gph2bin -c <config file> <data set> <binary data set>
+ */
+
+#include "General.h"
+#include "require.h"
+#include "Options.h"
+#include "InstanceParser.h"
+#include "BinaryDataSet.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+int main(int argc, char* argv[]) {
+  setenv("RNNOPTIONTYPE", "train", 1);
+
+  // the files are the arguments which are not switches
+  vector<string> files;
+  for(int i=1; i<argc; ++i) {
+    if(string(argv[i]) == "-c")
+      ++i;
+    else if(argv[i][0] != '-')
+      files.push_back(argv[i]);
+  }
+
+  try {
+    Options::instance()->parse_args(argc, argv);
+  } catch(Options::BadOptionSetting& e) {
+    cerr << e.what() << endl;
+    exit(EXIT_FAILURE);
+  }
+  Instance::orientations_budget(Options::instance()->orientations_memory() << 20);
+  if(files.size() != 2) {
+    cerr << "Usage: " << argv[0] << " -c <config file> <data set> <binary data set>" << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  ifstream is(files[0].c_str());
+  assure(is, files[0]);
+  uint length;
+  is >> length;
+  require(length, "Dataset size == 0");
+
+  InstanceParser parser;
+  BinaryDataSetWriter writer(files[1].c_str(), length);
+  for(uint i=0; i<length; ++i) {
+    Instance* instance = parser.read(is);
+    require(instance, "Error reading instance");
+    writer.write(instance);
+    delete instance;
+  }
+  writer.close();
+
+  cout << "Converted " << length << " instances to " << files[1] << endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,147 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+/*
+  Scaling benchmark of parallel training.
+
+  Trains the same initial network on the training set, once
+  serially and then in parallel with 2, 4, ... threads up to
+  num_threads (by default, the number of hardware threads):
+  asynchronous (Hogwild) workers with on line learning (-o),
+  synchronous workers otherwise. Reports the throughput and,
+  as a measure of convergence, the training error after each epoch.
+ */
+
+#include "General.h"
+#include "require.h"
+#include "Options.h"
+#include "DataSet.h"
+#include "Model.h"
+
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iomanip>
+#include <iostream>
+using namespace std;
+
+struct Run {
+  int threads;
+  double seconds; // training only, error evaluation excluded
+  vector<double> errors;
+};
+
+Run run(const string& netname, DataSet* trainingSet, int threads, bool onlinelearning) {
+  int epochs = atoi((Options::instance()->get_parameter("epochs")).c_str());
+  float eta = atof((Options::instance()->get_parameter("eta")).c_str());
+  float alpha = atof((Options::instance()->get_parameter("alpha")).c_str());
+
+  // networks read the parallel settings on construction
+  Options::instance()->num_threads(threads);
+  Options::instance()->parallel_training(threads == 1?SERIAL_TRAINING:
+					  onlinelearning?ASYNCHRONOUS_TRAINING:SYNCHRONOUS_TRAINING);
+  Model* model = Model::factory(netname);
+
+  Run r = { threads, .0, vector<double>() };
+  for(int epoch=1; epoch<=epochs; ++epoch) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if(onlinelearning)
+      model->trainOnline(trainingSet->begin(), trainingSet->end(), eta, alpha);
+    else {
+      model->accumulateGradient(trainingSet->begin(), trainingSet->end());
+      model->adjustWeights(eta, alpha);
+    }
+    r.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    r.errors.push_back(model->computeError(trainingSet));
+  }
+
+  delete model;
+  return r;
+}
+
+int main(int argc, char* argv[]) {
+  setenv("RNNOPTIONTYPE", "train", 1);
+
+  DataSet* trainingSet = NULL;
+  string netname;
+  
+  try {
+    Options::instance()->parse_args(argc,argv);
+    Instance::orientations_budget(Options::instance()->orientations_memory() << 20);
+    
+    netname = Options::instance()->get_parameter("netname");
+    if(!netname.length()) {
+      cerr << "Must specify a network file" << endl << endl;
+      throw Options::BadOptionSetting(Options::instance()->usage());
+    }
+
+    string training_set_fname = Options::instance()->get_parameter("training_set");
+    if(!training_set_fname.length()) {
+      cerr << "Must specify a training set" << endl << endl;
+      throw Options::BadOptionSetting(Options::instance()->usage());
+    }
+    trainingSet = new DataSet(training_set_fname.c_str());
+  } catch(const Options::BadOptionSetting& e) {
+    cerr << e.what() << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  bool onlinelearning = (atoi((Options::instance()->get_parameter("onlinelearning")).c_str()))?true:false;
+  int max_threads = Options::instance()->num_threads();
+  if(max_threads < 2)
+    max_threads = max(1u, thread::hardware_concurrency());
+
+  // all the runs start from the same random network
+  Model* model = Model::factory();
+  model->saveParameters(netname.c_str());
+  delete model;
+
+  cout << "Training set has " << trainingSet->size() << " instances, "
+       << (onlinelearning?"asynchronous on line":"synchronous batch") << " learning." << endl << endl
+       << "threads\tseconds\tinst/s\tspeedup\tE_training per epoch" << endl;
+
+  vector<int> threads;
+  for(int t=1; t<max_threads; t*=2)
+    threads.push_back(t);
+  threads.push_back(max_threads);
+
+  double serial_seconds = .0;
+  for(uint i=0; i<threads.size(); ++i) {
+    Run r = run(netname, trainingSet, threads[i], onlinelearning);
+    if(threads[i] == 1)
+      serial_seconds = r.seconds;
+
+    cout << r.threads << '\t' << setprecision(3) << r.seconds << '\t'
+	 << (long)(r.errors.size()*trainingSet->size()/r.seconds) << '\t'
+	 << setprecision(3) << serial_seconds/r.seconds << '\t' << setprecision(6);
+    for(uint e=0; e<r.errors.size(); ++e)
+      cout << r.errors[e] << ' ';
+    cout << endl;
+  }
+
+  delete trainingSet;
+  return EXIT_SUCCESS;
+}
@@ -29,49 +29,19 @@
 #include "Model.h"
 //#include "RecursiveNN.h"
 #include "Performance.h"
+#include "LearningRateSchedule.h"
 
 #include <cstdlib>
 #include <cfloat>
 #include <ctime>
 #include <map>
 #include <vector>
+#include <random>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 using namespace std;
 
-double adjustLearningRate(double curr_error, bool& restore_weights_flag, double& alpha) {
-  /*** Vogl adaptive acceleration learning method (additive) ***/
-  static double prev_eta = atof((Options::instance()->get_parameter("eta")).c_str());
-  static double prev_error = FLT_MAX;
-
-  double alpha_0 = 1e-1;
-  double phi = 1.05, beta = .5, epsilon = 1e-2;
-  double phi_additive = prev_eta/100;
-
-  double curr_eta;
-
-  if(curr_error < prev_error) {
-    curr_eta = phi_additive + prev_eta;
-    if(curr_eta > 1)
-      curr_eta = 1;
-    alpha = alpha_0;
-    prev_eta = curr_eta;
-    prev_error = curr_error;
-  } else if(curr_error < (1 + epsilon) * prev_error) {
-    curr_eta = beta * prev_eta;
-    alpha = 0;
-    prev_eta = curr_eta;
-    prev_error = curr_error;
-  } else {
-    restore_weights_flag = true;
-    curr_eta = beta * prev_eta;
-    alpha = 0;
-  }
-
-  return curr_eta;
-}
-
 void train(const string& netname, DataSet* trainingSet, DataSet* validationSet, ostream& os = cout) {
   // Get important training parameters
   bool onlinelearning = (atoi((Options::instance()->get_parameter("onlinelearning")).c_str()))?true:false;
@@ -79,6 +49,18 @@ void train(const string& netname, DataSet* trainingSet, DataSet* validationSet,
   
   int epochs = atoi((Options::instance()->get_parameter("epochs")).c_str());
   int savedelta = atoi((Options::instance()->get_parameter("savedelta")).c_str());
+  ParallelTraining parallel_training = Options::instance()->parallel_training();
+  // mini-batches: update the weights after a number of instances
+  // and/or nodes, going through the instances in a new order each epoch
+  int batch_size = atoi((Options::instance()->get_parameter("batch_size")).c_str());
+  int batch_nodes = atoi((Options::instance()->get_parameter("batch_nodes")).c_str());
+  bool minibatches = batch_size || batch_nodes;
+
+  // the line searches of L-BFGS are on the error of the whole training set
+  if(Options::instance()->optimizer() == LIMITED_MEMORY_BFGS && (onlinelearning || minibatches)) {
+    cerr << "The LBFGS optimizer requires batch learning" << endl;
+    exit(EXIT_FAILURE);
+  }
 
   Model* model;
   
@@ -91,6 +73,7 @@ void train(const string& netname, DataSet* trainingSet, DataSet* validationSet,
       exit(EXIT_FAILURE);
     }
     os << " Done." << endl;
+    model->lineSearchSet(trainingSet);
   } else {
     os << "Need some data to train network, please specify value for the --training-set argument\n";
     return;
@@ -101,37 +84,70 @@ void train(const string& netname, DataSet* trainingSet, DataSet* validationSet,
   bool restore_weights_flag = false;
   double curr_eta = atof((Options::instance()->get_parameter("eta")).c_str());
   double alpha = .9;
+
+  // the learning rate of each epoch
+  LearningRateSchedule* schedule;
+  try {
+    schedule = LearningRateSchedule::factory(Options::instance()->learning_rate_schedule(), curr_eta, epochs);
+  } catch(const LearningRateSchedule::BadScheduleCreation& e) {
+    cerr << e.what() << endl;
+    exit(EXIT_FAILURE);
+  }
+  // the schedule may ask to restore the weights before the last update,
+  // which are those of the previous epoch only in batch learning
+  if(schedule->rollback()) {
+    if(onlinelearning || minibatches) {
+      cerr << "The learning rate schedule restores the weights of the previous epoch, "
+	   << "it requires batch learning" << endl;
+      exit(EXIT_FAILURE);
+    }
+    model->enableRollback();
+  }
   
   double prev_error = FLT_MAX, min_error = FLT_MAX;
   int min_error_epoch = -1;
   double threshold_error = atof((Options::instance()->get_parameter("threshold_error")).c_str());
 
+  string seed_parameter = Options::instance()->get_parameter("seed");
+  unsigned int seed = seed_parameter.size()?strtoul(seed_parameter.c_str(), 0, 10):random_device()();
+  mt19937 rng(seed);
+  if(minibatches)
+    os << "Shuffling instances with seed " << seed << endl << endl;
+
   for(int epoch = 1; epoch<=epochs; epoch++) {
     os << "Epoch " << epoch << '\t';
     
-    for(DataSet::iterator it=trainingSet->begin(); it!=trainingSet->end(); ++it) {
-      // (*it)->print(os);
-      model->propagateStructuredInput(*it);
-      model->backPropagateError(*it);
-
-      /* stochastic (i.e. online) gradient descent */
-      if(onlinelearning) {
-      	if(restore_weights_flag)
-      	  model->restorePrevWeights();
-	
-      	model->adjustWeights(curr_eta, alpha);
-      	//curr_eta = adjustLearningRate(curr_train_error, restore_weights_flag, alpha);
+    if(minibatches) {
+      trainingSet->shuffle(rng);
+      // the gradient of each batch is accumulated (possibly by
+      // parallel workers) then used to update the weights
+      DataSet::const_iterator first = trainingSet->begin(), last;
+      for(; first!=trainingSet->end(); first=last) {
+	last = trainingSet->batch_end(first, batch_size, batch_nodes);
+	model->accumulateGradient(first, last);
+	model->adjustWeights(curr_eta, alpha);
+      }
+    } else if(!onlinelearning && parallel_training == SYNCHRONOUS_TRAINING)
+      // the gradient over the whole training set, the
+      // instances being shared among parallel workers
+      model->accumulateGradient(trainingSet->begin(), trainingSet->end());
+    else if(onlinelearning && parallel_training == ASYNCHRONOUS_TRAINING)
+      // parallel workers update the weights after each of their instances
+      model->trainOnline(trainingSet->begin(), trainingSet->end(), curr_eta, alpha);
+    else
+      for(DataSet::iterator it=trainingSet->begin(); it!=trainingSet->end(); ++it) {
+	// (*it)->print(os);
+	model->propagateStructuredInput(*it);
+	model->backPropagateError(*it);
+
+	/* stochastic (i.e. online) gradient descent */
+	if(onlinelearning)
+	  model->adjustWeights(curr_eta, alpha);
       }
-    }
 
     /* batch weight update */
-    if(!onlinelearning) {
-      if(restore_weights_flag)
-    	model->restorePrevWeights();
-
+    if(!onlinelearning && !minibatches)
       model->adjustWeights(curr_eta, alpha);
-      //curr_eta = adjustLearningRate(curr_train_error, restore_weights_flag, alpha);
-    }
 
     double error;
     double error_training_set = model->computeError(trainingSet);
@@ -158,7 +174,14 @@ void train(const string& netname, DataSet* trainingSet, DataSet* validationSet,
       break;
     }
 
-    prev_error = error;
+    // the learning rate (and possibly the momentum term) of the next epoch
+    curr_eta = schedule->update(epoch, error, alpha, restore_weights_flag);
+    if(restore_weights_flag) {
+      // back to the weights of the previous epoch, and to their error
+      model->rollback();
+      restore_weights_flag = false;
+    } else
+      prev_error = error;
 
     // save network every 'savedelta' epochs
     if(!(epoch % savedelta)) {
@@ -173,6 +196,7 @@ void train(const string& netname, DataSet* trainingSet, DataSet* validationSet,
 
   // deallocate Recursive Neural Network instace
   delete model; model = 0;
+  delete schedule; schedule = 0;
 
 }
 
@@ -209,6 +233,7 @@ int main(int argc, char* argv[]) {
   
   try {
     Options::instance()->parse_args(argc,argv);
+    Instance::orientations_budget(Options::instance()->orientations_memory() << 20);
     
     netname = Options::instance()->get_parameter("netname");
     if(!netname.length()) {
@@ -0,0 +1,190 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "catch.hpp"
+
+#include "ParameterArena.h"
+#include "Options.h"
+#include "NodeWorkspace.h"
+#include "InstanceParser.h"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <fstream>
+using namespace std;
+
+TEST_CASE("Parameters layout and buffers", "[arena]") {
+  ParameterLayout layout;
+  CHECK(layout.size() == 0);
+  
+  // a 4x3 and a 6x9 matrix
+  CHECK(layout.add(4, 3) == 0);
+  CHECK(layout.add(6, 9) == 1);
+  CHECK(layout.num_blocks() == 2);
+
+  // rows are padded to the alignment boundary
+  CHECK(layout.stride(0) == ParameterLayout::row_alignment);
+  CHECK(layout.stride(1) % ParameterLayout::row_alignment == 0);
+  CHECK(layout.stride(1) >= 9);
+  CHECK(layout.offset(0) == 0);
+  CHECK(layout.offset(1) == (size_t)4*layout.stride(0));
+  CHECK(layout.size() == layout.offset(1) + 6*layout.stride(1));
+
+  ParameterArena<double> w, g;
+  w.allocate(layout);
+  g.allocate(layout);
+  CHECK(w.size() == layout.size());
+  CHECK((size_t)w.data() % ParameterLayout::alignment == 0);
+
+  SECTION("buffers are reset on allocation") {
+    for(size_t p=0; p<w.size(); ++p)
+      CHECK(w.data()[p] == 0);
+  }
+
+  SECTION("matrix views") {
+    Matrix<double> m0 = w.block(0), m1 = w.block(1);
+    CHECK(m0.rows() == 4); CHECK(m0.cols() == 3);
+    CHECK(m1.rows() == 6); CHECK(m1.cols() == 9);
+    
+    m0[3][2] = 1.5;
+    m1[0][0] = 2.5;
+    m1[5][8] = 3.5;
+    CHECK(w.data()[3*layout.stride(0) + 2] == 1.5);
+    CHECK(w.data()[layout.offset(1)] == 2.5);
+    CHECK(w.data()[layout.offset(1) + 5*layout.stride(1) + 8] == 3.5);
+
+    // the same position refers to the same connection in another buffer
+    g.assign(w);
+    CHECK(g.block(1)[5][8] == 3.5);
+    CHECK(g.block(0)[3][2] == 1.5);
+    
+    w.reset();
+    CHECK(w.block(1)[5][8] == 0);
+    CHECK(g.block(1)[5][8] == 3.5);
+  }
+
+  SECTION("swapping buffers") {
+    w.block(0)[1][1] = 1.5;
+    g.block(0)[1][1] = 2.5;
+    const double* wd = w.data();
+    const double* gd = g.data();
+    
+    w.swap(g);
+    CHECK(w.data() == gd); CHECK(g.data() == wd);
+    CHECK(w.block(0)[1][1] == 2.5);
+    CHECK(g.block(0)[1][1] == 1.5);
+
+    g.release();
+    CHECK(!g.allocated());
+    CHECK(w.allocated());
+  }
+
+  SECTION("buffers of different types share the layout") {
+    ParameterArena<float> f;
+    f.allocate(layout);
+    f.block(1)[2][4] = .25f;
+    w.assign(f);
+    CHECK(w.block(1)[2][4] == .25);
+  }
+}
+
+TEST_CASE("Node activations in a single block", "[arena]") {
+  // two orientations, two folding layers (4, 3 units) and
+  // an output layer (2 units) for IO-isomorph transductions
+  vector<int> lnunits(3); lnunits[0] = 4; lnunits[1] = 3; lnunits[2] = 2;
+  NodeArena<double> arena;
+  arena.allocate(3, 2, lnunits, 2, 1, true);
+  CHECK(arena.allocated());
+
+  vector<NodeActivations<double> > nodes(3);
+  for(int n=0; n<3; ++n)
+    arena.bind(n, &nodes[n]);
+
+  // the buffers of a node follow one another,
+  // each node begins on its own cache line
+  for(int n=0; n<3; ++n) {
+    NodeActivations<double>& na = nodes[n];
+    CHECK((size_t)na._layers_activations[0][0] % 64 == 0);
+    CHECK(na._layers_activations[0][1] == na._layers_activations[0][0] + 4);
+    CHECK(na._layers_activations[1][0] == na._layers_activations[0][1] + 3);
+    CHECK(na._delta_lr[0] == na._layers_activations[1][1] + 3);
+    CHECK(na._delta_lr[1] == na._delta_lr[0] + 3);
+    CHECK(na._h_layers_activations[0] == na._delta_lr[1] + 3);
+  }
+  CHECK(nodes[1]._layers_activations[0][0] > nodes[0]._h_layers_activations[0] + 1);
+
+  // a single reset clears all of them
+  for(int n=0; n<3; ++n) {
+    nodes[n]._layers_activations[1][0][2] = 1.;
+    nodes[n]._delta_lr[1][0] = 1.;
+    nodes[n]._h_layers_activations[0][1] = 1.;
+  }
+  arena.reset();
+  for(int n=0; n<3; ++n) {
+    CHECK(nodes[n]._layers_activations[1][0][2] == 0);
+    CHECK(nodes[n]._delta_lr[1][0] == 0);
+    CHECK(nodes[n]._h_layers_activations[0][1] == 0);
+  }
+}
+
+TEST_CASE("Node activations reused across instances", "[arena]") {
+  setenv("RNNOPTIONTYPE", "train", 1);
+  char* argv[] = { (char*)"dummy", (char*)"-c", (char*)"data/rnn.conf" };
+  Options::instance()->parse_args(3, argv);
+
+  InstanceParser p;
+  Instance* instances[2];
+  for(int i=0; i<2; ++i) {
+    ifstream is("data/sequence.gph");
+    instances[i] = p.read(is);
+  }
+  const int nn = instances[0]->num_nodes();
+
+  vector<int> lnunits(2); lnunits[0] = 4; lnunits[1] = 3;
+  NodeWorkspace<float> workspace;
+  workspace.layout(2, lnunits, 2, 0, false);
+
+  // the nodes of a batch follow one another, instances in order
+  workspace.assign(instances, instances+2);
+  NodeActivations<float>* first = workspace.nodes(instances[0]);
+  CHECK(workspace.nodes(instances[1]) == first + nn);
+  first[nn-1]._delta_lr[1][2] = 1.f;
+  workspace.nodes(instances[1])[0]._layers_activations[0][1][0] = 1.f;
+
+  // a smaller batch takes the same block, only the
+  // deltas are cleared, when first reached
+  workspace.assign(instances+1, instances+2);
+  CHECK(workspace.nodes(instances[1]) == first);
+  CHECK(first[nn]._layers_activations[0][1][0] == 1.f);
+  CHECK(first[nn-1]._delta_lr[1][2] == 1.f);
+  float* delta = workspace.delta(first[nn-1], 1);
+  CHECK(delta == first[nn-1]._delta_lr[1]);
+  CHECK(delta[2] == 0);
+  delta[2] = 2.f;
+  CHECK(workspace.delta(first[nn-1], 1)[2] == 2.f);
+  CHECK(workspace.delta(first[nn-1], 0) == first[nn-1]._delta_lr[0]);
+
+  for(int i=0; i<2; ++i)
+    delete instances[i];
+}
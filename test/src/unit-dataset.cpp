@@ -27,9 +27,34 @@
 #include "General.h"
 #include "Options.h"
 #include "DataSet.h"
+#include "InstanceParser.h"
+#include "BinaryDataSet.h"
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 using namespace std;
 
+// the instance read from a binary data set is the one written
+static void check_mapped(Instance* instance, Instance* mapped) {
+  CHECK(mapped->id() == instance->id());
+  CHECK(mapped->domain() == instance->domain());
+  CHECK(mapped->target() == instance->target());
+  REQUIRE(mapped->num_nodes() == instance->num_nodes());
+  for(uint t=0; t<instance->num_nodes(); ++t) {
+    CHECK(mapped->node(t)->input() == instance->node(t)->input());
+    CHECK(mapped->node(t)->target() == instance->node(t)->target());
+  }
+
+  REQUIRE(mapped->num_orient() == instance->num_orient());
+  CHECK(mapped->maximum_indegree() == instance->maximum_indegree());
+  CHECK(mapped->maximum_outdegree() == instance->maximum_outdegree());
+  for(uint o=0; o<instance->num_orient(); ++o) {
+    CHECK(mapped->topological_order(o) == instance->topological_order(o));
+    CHECK(mapped->levels(o) == instance->levels(o));
+    CHECK(equal(*mapped->orientation(o), *instance->orientation(o)));
+  }
+}
+
 
 TEST_CASE("Basic dataset tests", "[dataset]") {
   // prepare arguments and read configuration file
@@ -62,7 +87,7 @@ TEST_CASE("Basic dataset tests", "[dataset]") {
 
     CHECK(instance->num_orient() == 1);
     
-    DPAG* doag = instance->orientation(0);
+    shared_ptr<DPAG> doag = instance->orientation(0);
     int V = boost::num_vertices(*doag);
     CHECK(V == instance->num_nodes());
 
@@ -192,3 +217,90 @@ TEST_CASE("Basic dataset tests", "[dataset]") {
     }
   }
 }
+
+TEST_CASE("Dataset batches", "[dataset]") {
+  setenv("RNNOPTIONTYPE", "train", 1);
+  char* argv[] = { (char*)"dummy", (char*)"-c", (char*)"data/rnn.conf" };
+  Options::instance()->parse_args(3, argv);
+
+  Options::instance()->domain(DOAG);
+  DataSet ds("data/dataset.gph");
+  REQUIRE(ds.size() == 3);
+
+  // by number of instances, the last batch holds those left
+  DataSet::const_iterator first = ds.begin();
+  CHECK(ds.batch_end(first, 2) - first == 2);
+  CHECK(ds.batch_end(first + 2, 2) == ds.end());
+  CHECK(ds.batch_end(first, 0) == ds.end());
+
+  // by number of nodes (4 per instance), a batch
+  // closes with the instance reaching the budget
+  CHECK(ds.batch_end(first, 0, 4) - first == 1);
+  CHECK(ds.batch_end(first, 0, 5) - first == 2);
+  CHECK(ds.batch_end(first, 1, 100) - first == 1);
+
+  // the same seed gives the same order
+  vector<Instance*> original(ds.begin(), ds.end());
+  mt19937 rng1(7), rng2(7);
+  ds.shuffle(rng1);
+  vector<Instance*> shuffled(ds.begin(), ds.end());
+  ds.assign(original.begin(), original.end());
+  ds.shuffle(rng2);
+  CHECK(vector<Instance*>(ds.begin(), ds.end()) == shuffled);
+}
+
+TEST_CASE("Binary dataset", "[dataset]") {
+  setenv("RNNOPTIONTYPE", "train", 1);
+  char* argv[] = { (char*)"dummy", (char*)"-c", (char*)"data/rnn.conf" };
+  Options::instance()->parse_args(3, argv);
+
+  SECTION("DOAG") {
+    Options::instance()->domain(DOAG);
+    Options::instance()->transduction(IO_ISOMORPH);
+    DataSet ds("data/dataset.gph");
+    {
+      BinaryDataSetWriter writer("dataset.bin", ds.size());
+      for(DataSet::iterator it=ds.begin(); it!=ds.end(); ++it)
+	writer.write(*it);
+    }
+    CHECK(BinaryDataSetReader::is_binary("dataset.bin"));
+    CHECK_FALSE(BinaryDataSetReader::is_binary("data/dataset.gph"));
+
+    DataSet mapped("dataset.bin");
+    REQUIRE(mapped.size() == ds.size());
+    CHECK(mapped.num_nodes() == ds.num_nodes());
+    for(uint i=0; i<ds.size(); ++i)
+      check_mapped(ds[i], mapped[i]);
+    remove("dataset.bin");
+  }
+
+  SECTION("UG and grid") {
+    Domain domains[] = { UG, GRID2D };
+    Transduction transductions[] = { SUPER_SOURCE, IO_ISOMORPH };
+    const char* files[] = { "data/dpag.gph", "data/grid.gph" };
+    for(int d=0; d<2; ++d) {
+      Options::instance()->domain(domains[d]);
+      Options::instance()->transduction(transductions[d]);
+      InstanceParser p;
+      ifstream is(files[d]);
+      Instance* instance = p.read(is);
+      is.close();
+      {
+	BinaryDataSetWriter writer("instance.bin", 1);
+	writer.write(instance);
+      }
+
+      DataSet mapped("instance.bin");
+      REQUIRE(mapped.size() == 1);
+      check_mapped(instance, mapped[0]);
+      if(domains[d] == GRID2D) {
+	CHECK(mapped[0]->grid_rows() == instance->grid_rows());
+	CHECK(mapped[0]->grid_cols() == instance->grid_cols());
+      }
+
+      delete instance;
+      remove("instance.bin");
+    }
+  }
+}
+
@@ -227,6 +227,14 @@ TEST_CASE("DPAG functions with various data structures", "[dpag]") {
       CHECK(top_sort.size() == boost::num_vertices(sequence));
       for(uint i=0; i<boost::num_vertices(sequence); ++i)
 	CHECK(top_sort[i] == T-i-1);
+
+      // one node per level, from the first element of the sequence
+      vector<vector<int> > levels = topological_levels(sequence, top_sort);
+      CHECK(levels.size() == T);
+      for(uint i=0; i<levels.size(); ++i) {
+	CHECK(levels[i].size() == 1);
+	CHECK(levels[i][0] == i);
+      }
     }
   }
 
@@ -288,6 +296,51 @@ TEST_CASE("DPAG functions with various data structures", "[dpag]") {
       CHECK(top_sort[2] <= 3);
       CHECK(top_sort[3] >= 2);
       CHECK(top_sort[3] <= 3);
+
+      // leaves first, then nodes whose children are all in previous levels
+      vector<vector<int> > levels = topological_levels(dpag, top_sort);
+      REQUIRE(levels.size() == 3);
+      CHECK(levels[0].size() == 2);
+      CHECK(find(levels[0].begin(), levels[0].end(), 2) != levels[0].end());
+      CHECK(find(levels[0].begin(), levels[0].end(), 3) != levels[0].end());
+      CHECK(levels[1] == vector<int>(1, 1));
+      CHECK(levels[2] == vector<int>(1, 0));
+    }
+
+    SECTION("compact form") {
+      // same children, in the same order, as the out edges
+      CSRGraph g(dpag, true);
+      REQUIRE(g.num_vertices() == 4);
+      REQUIRE(g.num_edges() == 4);
+      CHECK(g.out_begin(0) == 0);
+      CHECK(g.out_end(0) == 2);
+      CHECK(g.out_end(1) == 4);
+      CHECK(g.out_begin(2) == g.out_end(2));
+      CHECK(g.out_begin(3) == g.out_end(3));
+      CHECK(g.target(0) == 1);
+      CHECK(g.position(0) == 0);
+      CHECK(g.target(1) == 3);
+      CHECK(g.position(1) == 1);
+      CHECK(g.target(2) == 2);
+      CHECK(g.position(2) == 0);
+      CHECK(g.target(3) == 3);
+      CHECK(g.position(3) == 1);
+
+      // and the parents
+      REQUIRE(g.has_reverse());
+      CHECK(g.in_begin(0) == g.in_end(0));
+      REQUIRE(g.in_end(3) - g.in_begin(3) == 2);
+      CHECK(g.source(g.in_begin(1)) == 0);
+      CHECK(g.source(g.in_begin(2)) == 1);
+      CHECK(g.source(g.in_begin(3)) == 0);
+      CHECK(g.source(g.in_begin(3)+1) == 1);
+      CHECK_FALSE(CSRGraph(dpag).has_reverse());
+
+      // back to the same DPAG
+      DPAG d;
+      g.to_dpag(&d);
+      CHECK(equal(d, dpag));
+      CHECK(equal(dpag, d));
     }
   }
 
@@ -356,6 +409,15 @@ TEST_CASE("DPAG functions with various data structures", "[dpag]") {
 	CHECK(j < j2);
 	CHECK(j2 < j1);
       }
+
+      // levels are the anti-diagonals of the grid, from the bottom-right corner
+      vector<vector<int> > levels = topological_levels(grid, top_sort);
+      CHECK(levels.size() == 2*N-1);
+      for(uint l=0; l<levels.size(); ++l) {
+	CHECK(levels[l].size() == (l<(uint)N?l+1:2*N-1-l));
+	for(uint v=0; v<levels[l].size(); ++v)
+	  CHECK((levels[l][v]/N + levels[l][v]%N) == 2*(N-1)-l);
+      }
       
     }
   }
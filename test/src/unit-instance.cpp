@@ -30,6 +30,7 @@
 #include <cstdio>
 #include <vector>
 #include <fstream>
+#include <algorithm>
 using namespace std;
 
 typedef unsigned int uint;
@@ -78,7 +79,7 @@ TEST_CASE("Basic instance tests", "[instance]") {
       CHECK(instance->num_orient() == 1);
 
       // CHECK_THROWS(instance->orientation(1));
-      DPAG* sequence = instance->orientation(0);
+      shared_ptr<DPAG> sequence = instance->orientation(0);
 
       int T = boost::num_vertices(*sequence);
       CHECK(T == instance->num_nodes());
@@ -151,7 +152,7 @@ TEST_CASE("Basic instance tests", "[instance]") {
       CHECK(instance->num_orient() == 2);
 
       // CHECK_THROWS(instance->orientation(2));
-      DPAG* lrseq = instance->orientation(1);
+      shared_ptr<DPAG> lrseq = instance->orientation(1);
       int T = boost::num_vertices(*lrseq);
       CHECK(T == instance->num_nodes());
       VertexId vertex_id = boost::get(boost::vertex_index, *lrseq);
@@ -225,7 +226,7 @@ TEST_CASE("Basic instance tests", "[instance]") {
       CHECK(instance->maximum_outdegree() == 2);
       CHECK(instance->num_orient() == 1);
 
-      DPAG* doag = instance->orientation(0);
+      shared_ptr<DPAG> doag = instance->orientation(0);
       int V = boost::num_vertices(*doag);
       CHECK(V == instance->num_nodes());
       
@@ -322,7 +323,7 @@ TEST_CASE("Basic instance tests", "[instance]") {
       CHECK(instance->maximum_outdegree() == 3);
       CHECK(instance->num_orient() == 2);
 
-      DPAG* doag = instance->orientation(1);
+      shared_ptr<DPAG> doag = instance->orientation(1);
       int V = boost::num_vertices(*doag);
       CHECK(V == instance->num_nodes());
       
@@ -420,9 +421,11 @@ TEST_CASE("Basic instance tests", "[instance]") {
       CHECK(instance->maximum_indegree() == 2);
       CHECK(instance->maximum_outdegree() == 2);
       CHECK(instance->num_orient() == 4);
+      CHECK(instance->grid_rows() == 3);
+      CHECK(instance->grid_cols() == 3);
 
       SECTION("NWSE") {
-  	DPAG* grid = instance->orientation(0);
+  	shared_ptr<DPAG> grid = instance->orientation(0);
   	EdgeId edge_id = boost::get(boost::edge_index, *grid);
 
   	Vertex_d v = boost::vertex(0, *grid);
@@ -454,7 +457,7 @@ TEST_CASE("Basic instance tests", "[instance]") {
   	CHECK(out_i == out_end);
       }
       SECTION("SENW") {
-  	DPAG* grid = instance->orientation(1);
+  	shared_ptr<DPAG> grid = instance->orientation(1);
   	EdgeId edge_id = boost::get(boost::edge_index, *grid);
 
   	Vertex_d v = boost::vertex(0, *grid);
@@ -486,7 +489,7 @@ TEST_CASE("Basic instance tests", "[instance]") {
   	CHECK(in_i == in_end);
       }
       SECTION("NESW") {
-  	DPAG* grid = instance->orientation(2);
+  	shared_ptr<DPAG> grid = instance->orientation(2);
   	EdgeId edge_id = boost::get(boost::edge_index, *grid);
 
   	Vertex_d v = boost::vertex(2, *grid);
@@ -519,7 +522,7 @@ TEST_CASE("Basic instance tests", "[instance]") {
   	CHECK(++out_i == out_end);
       }
       SECTION("SWNE") {
-  	DPAG* grid = instance->orientation(3);
+  	shared_ptr<DPAG> grid = instance->orientation(3);
   	EdgeId edge_id = boost::get(boost::edge_index, *grid);
 
   	Vertex_d v = boost::vertex(6, *grid);
@@ -592,3 +595,122 @@ TEST_CASE("Basic instance tests", "[instance]") {
     }
   }
 }
+
+TEST_CASE("Implicit topology", "[instance]") {
+  setenv("RNNOPTIONTYPE", "train", 1);
+  char* argv[] = { (char*)"dummy", (char*)"-c", (char*)"data/rnn.conf" };
+  Options::instance()->parse_args(3, argv);
+  Options::instance()->transduction(IO_ISOMORPH);
+
+  // the connectivity computed from the indices of the nodes
+  // is the one of the orientations derived explicitly
+  Domain domains[] = { SEQUENCE, LINEARCHAIN, GRID2D, GRID2D };
+  const char* files[] = { "data/sequence.gph", "data/sequence.gph", "data/grid.gph", "data/grid_3x4.gph" };
+  for(int d=0; d<4; ++d) {
+    Options::instance()->domain(domains[d]);
+    InstanceParser p;
+    ifstream is(files[d]);
+    Instance* instance = p.read(is);
+    is.close();
+
+    REQUIRE(instance->implicit());
+    for(uint o=0; o<instance->num_orient(); ++o) {
+      Instance::OrientationRef orientation = instance->oriented(o);
+      const CSRGraph& graph = orientation->graph;
+      CHECK(instance->root(o) == orientation->order[0]);
+
+      REQUIRE(instance->num_levels(o) == orientation->levels.size());
+      for(uint l=0; l<instance->num_levels(o); ++l) {
+	vector<int> level;
+	for(int k=0; k<instance->level_size(o, l); ++k)
+	  level.push_back(instance->level_node(o, l, k));
+	vector<int> expected = orientation->levels[l];
+	sort(level.begin(), level.end());
+	sort(expected.begin(), expected.end());
+	CHECK(level == expected);
+      }
+
+      for(uint t=0; t<instance->num_nodes(); ++t) {
+	int children[2];
+	const int nc = instance->children(o, t, children);
+	REQUIRE(nc == graph.out_end(t) - graph.out_begin(t));
+	for(int c=graph.out_begin(t); c<graph.out_end(t); ++c)
+	  CHECK(children[graph.position(c)] == graph.target(c));
+      }
+    }
+
+    delete instance;
+  }
+
+  // a grid which is not square tells rows from columns: node
+  // (i,j) is i*4+j, its children on the same row come first
+  Options::instance()->domain(GRID2D);
+  InstanceParser p;
+  ifstream is("data/grid_3x4.gph");
+  Instance* instance = p.read(is);
+  is.close();
+
+  REQUIRE(instance->grid_rows() == 3);
+  REQUIRE(instance->grid_cols() == 4);
+  int roots[] = { 0, 11, 3, 8 };
+  int children[][2] = { { 6, 9 }, { 4, 1 }, { 4, 9 }, { 6, 1 } };
+  for(uint o=0; o<instance->num_orient(); ++o) {
+    CHECK(instance->root(o) == roots[o]);
+    CHECK(instance->num_levels(o) == 6);
+    CHECK(instance->level_size(o, 2) == 3);
+    CHECK(instance->level_size(o, 4) == 2);
+
+    int c[2];
+    REQUIRE(instance->children(o, 5, c) == 2);
+    CHECK(c[0] == children[o][0]);
+    CHECK(c[1] == children[o][1]);
+
+    // and so does the explicit orientation
+    Instance::OrientationRef orientation = instance->oriented(o);
+    const CSRGraph& graph = orientation->graph;
+    REQUIRE(graph.out_end(5) - graph.out_begin(5) == 2);
+    CHECK(graph.target(graph.out_begin(5)) == children[o][0]);
+    CHECK(graph.target(graph.out_begin(5)+1) == children[o][1]);
+  }
+
+  delete instance;
+}
+
+TEST_CASE("Orientations on demand", "[instance]") {
+  setenv("RNNOPTIONTYPE", "train", 1);
+  char* argv[] = { (char*)"dummy", (char*)"-c", (char*)"data/rnn.conf" };
+  Options::instance()->parse_args(3, argv);
+  Options::instance()->domain(UG);
+  Options::instance()->transduction(SUPER_SOURCE);
+
+  InstanceParser p;
+  Instance* instances[2];
+  for(int i=0; i<2; ++i) {
+    ifstream is("data/dpag.gph");
+    instances[i] = p.read(is);
+  }
+
+  // derived once, then the same until dropped
+  Instance::OrientationRef o0 = instances[0]->oriented(0);
+  CHECK(o0->order.size() == instances[0]->num_nodes());
+  CHECK(o0->graph.num_vertices() == (int)instances[0]->num_nodes());
+  CHECK(instances[0]->oriented(0) == o0);
+  CHECK(instances[0]->oriented(1) != o0);
+
+  // over budget, the least recently used are dropped: those
+  // still held stay valid, and are derived again the same
+  Instance::orientations_budget(1);
+  Instance::OrientationRef o1 = instances[1]->oriented(0);
+  CHECK(instances[0]->oriented(0) != o0);
+  CHECK(instances[0]->oriented(0)->order == o0->order);
+  CHECK(instances[0]->oriented(0)->levels == o0->levels);
+  CHECK(o1->order == o0->order);
+  Instance::orientations_budget(0);
+
+  CHECK(instances[1]->maximum_indegree() == 3);
+  CHECK(instances[1]->maximum_outdegree() == 3);
+
+  for(int i=0; i<2; ++i)
+    delete instances[i];
+}
+
@@ -0,0 +1,114 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "catch.hpp"
+
+#include "Kernels.h"
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// vector lengths covering the remainders of every vector width
+static const int lengths[] = { 0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 100 };
+static const int nlengths = sizeof(lengths)/sizeof(int);
+
+template<typename T>
+static vector<T> sequence(int n, T scale) {
+  vector<T> v(n + 1); // avoid taking the address of an empty vector
+  for(int i=0; i<n; ++i)
+    v[i] = scale * T((i*7)%11 - 5);
+  return v;
+}
+
+template<typename T>
+static void check_primitives() {
+  for(int l=0; l<nlengths; ++l) {
+    int n = lengths[l];
+    vector<T> x = sequence(n, T(.25)), y = sequence(n, T(-.5)), z(y);
+
+    T sum = 0;
+    for(int i=0; i<n; ++i)
+      sum += x[i] * y[i];
+    CHECK(fabs(dot(n, &x[0], &y[0]) - sum) <= 1e-5 * (1 + fabs(sum)));
+
+    axpy(n, T(1.5), &x[0], &z[0]);
+    for(int i=0; i<n; ++i)
+      CHECK(fabs(z[i] - (y[i] + T(1.5)*x[i])) <= 1e-6);
+    CHECK(z[n] == y[n]); // nothing written past the end
+  }
+}
+
+TEST_CASE("Runtime dispatched vector kernels", "[kernels]") {
+  InstructionSet supported = supported_instruction_set();
+  CHECK(select_instruction_set() == supported);
+  CHECK(instruction_set() == supported);
+
+  // not supported instruction sets fall back to the best one available
+  CHECK(select_instruction_set(AVX512_ISA) <= supported);
+  
+  for(int isa=SCALAR_ISA; isa<=supported; ++isa) {
+    CHECK(select_instruction_set((InstructionSet)isa) == isa);
+    INFO("instruction set " << instruction_set_name((InstructionSet)isa));
+    
+    check_primitives<float>();
+    check_primitives<double>();
+
+    // float vectors accumulated into double ones
+    for(int l=0; l<nlengths; ++l) {
+      int n = lengths[l];
+      vector<float> x = sequence(n, .1f);
+      vector<double> y = sequence(n, -.5), z(y);
+      axpy(n, .3, &x[0], &z[0]);
+      for(int i=0; i<n; ++i)
+	CHECK(fabs(z[i] - (y[i] + .3*double(x[i]))) <= 1e-15);
+      CHECK(z[n] == y[n]);
+    }
+
+    // C += alpha*A*B, alpha*A*B^T and alpha*A^T*B with A 3x5, B 5x17
+    const int m = 3, k = 5, n = 17;
+    vector<double> a = sequence(m*k, .5), b = sequence(k*n, .25), bt(n*k), at(k*m);
+    for(int i=0; i<k; ++i) {
+      for(int j=0; j<n; ++j)
+	bt[j*k + i] = b[i*n + j];
+      for(int j=0; j<m; ++j)
+	at[i*m + j] = a[j*k + i];
+    }
+    
+    vector<double> c(m*n, 1.), c_nt(m*n, 1.), c_tn(m*n, 1.);
+    gemm_nn(m, n, k, 2., &a[0], k, &b[0], n, &c[0], n);
+    gemm_nt(m, n, k, 2., &a[0], k, &bt[0], k, &c_nt[0], n);
+    gemm_tn(m, n, k, 2., &at[0], m, &b[0], n, &c_tn[0], n);
+    for(int i=0; i<m; ++i)
+      for(int j=0; j<n; ++j) {
+	double sum = 0;
+	for(int p=0; p<k; ++p)
+	  sum += a[i*k + p] * b[p*n + j];
+	CHECK(fabs(c[i*n + j] - (1 + 2*sum)) < 1e-12);
+	CHECK(fabs(c_nt[i*n + j] - (1 + 2*sum)) < 1e-12);
+	CHECK(fabs(c_tn[i*n + j] - (1 + 2*sum)) < 1e-12);
+      }
+  }
+  
+  select_instruction_set();
+}
@@ -0,0 +1,271 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures
+ *
+ * Copyright (C) 2018 Alessandro Vullo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+#include "catch.hpp"
+
+#include "General.h"
+#include "Options.h"
+#include "DataSet.h"
+#include "Model.h"
+#include "InstanceParser.h"
+#include "RecursiveNN.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+using namespace std;
+
+// read the configuration of a test network, with the serial
+// node schedule and the optimizer of the update rules below
+static void configure(const char* conf) {
+  setenv("RNNOPTIONTYPE", "train", 1);
+  Options::instance()->folding_schedule(NODE_SCHEDULE);
+  char* argv[] = { (char*)"dummy", (char*)"-c", (char*)conf };
+  Options::instance()->parse_args(3, argv);
+
+  Options::instance()->folding_schedule(NODE_SCHEDULE);
+  Options::instance()->orientation_schedule(SEQUENTIAL_ORIENTATIONS);
+  Options::instance()->weights_layout(OUTPUT_MAJOR);
+  Options::instance()->num_threads(1);
+  Options::instance()->parallel_training(SERIAL_TRAINING);
+  Options::instance()->optimizer(MOMENTUM_GRADIENT_DESCENT);
+}
+
+// add the instance of each file to the data set
+static void add_instances(DataSet& ds, const char* const* files, int nfiles) {
+  for(int f=0; f<nfiles; ++f) {
+    InstanceParser p;
+    ifstream is(files[f]);
+    ds.add(p.read(is));
+  }
+}
+
+// the header (processing flags, dimensions and layers)
+// and the weights of a network file
+static vector<double> read_weights(const char* filename, string& header) {
+  ifstream is(filename);
+  header.clear();
+  string line;
+  for(int i=0; i<4 && getline(is, line); ++i)
+    header += line + '\n';
+
+  vector<double> w;
+  double x;
+  while(is >> x)
+    w.push_back(x);
+  return w;
+}
+
+static vector<double> read_weights(const char* filename) {
+  string header;
+  return read_weights(filename, header);
+}
+
+static void write_weights(const char* filename, const string& header, const vector<double>& w) {
+  ofstream os(filename);
+  os << header << endl;
+  os.precision(17);
+  os.setf(ios::scientific);
+  for(uint p=0; p<w.size(); ++p)
+    os << w[p] << endl;
+}
+
+// the weights of the network in the given file after one batch
+// update over the data set, with the current options
+static vector<double> updated_weights(const char* filename, DataSet& ds) {
+  Model* model = Model::factory(filename);
+  model->accumulateGradient(ds.begin(), ds.end());
+  model->adjustWeights(.1, .5);
+  model->saveParameters("updated.net");
+  delete model;
+
+  vector<double> w = read_weights("updated.net");
+  remove("updated.net");
+  return w;
+}
+
+static void check_same_weights(const vector<double>& w, const vector<double>& expected) {
+  REQUIRE(w.size() == expected.size());
+  for(uint p=0; p<w.size(); ++p)
+    CHECK(w[p] == Approx(expected[p]).epsilon(1e-12));
+}
+
+TEST_CASE("Equivalence of the folding engines", "[network]") {
+  // the same update from the same weights, whatever the engine:
+  // each is checked against the node schedule with serial training
+
+  SECTION("DOAG") {
+    configure("data/network_doag.conf");
+    DataSet ds("data/dataset.gph");
+    Model* model = Model::factory();
+    model->saveParameters("initial.net");
+    delete model;
+    vector<double> expected = updated_weights("initial.net", ds);
+
+    // the incoming weights of the units contiguous or not
+    Options::instance()->weights_layout(INPUT_MAJOR);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+
+    // the levels of all instances as blocks of rows
+    Options::instance()->folding_schedule(LEVEL_SCHEDULE);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+
+    // rows of the levels split among threads
+    Options::instance()->num_threads(2);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+
+    // the gradients of the shares of the workers summed
+    Options::instance()->parallel_training(SYNCHRONOUS_TRAINING);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+    Options::instance()->folding_schedule(NODE_SCHEDULE);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+
+    remove("initial.net");
+  }
+
+  SECTION("UG") {
+    configure("data/network_ug.conf");
+    const char* files[] = { "data/dpag.gph", "data/dpag.gph" };
+    DataSet ds;
+    add_instances(ds, files, 2);
+    Model* model = Model::factory();
+    model->saveParameters("initial.net");
+    delete model;
+    vector<double> expected = updated_weights("initial.net", ds);
+
+    Options::instance()->folding_schedule(LEVEL_SCHEDULE);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+
+    // orientations on separate threads
+    Options::instance()->orientation_schedule(CONCURRENT_ORIENTATIONS);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+    Options::instance()->num_threads(4);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+    Options::instance()->folding_schedule(NODE_SCHEDULE);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+
+    // workers with concurrent orientations of their own
+    Options::instance()->parallel_training(SYNCHRONOUS_TRAINING);
+    Options::instance()->num_threads(2);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+
+    remove("initial.net");
+  }
+
+  SECTION("Sequences") {
+    configure("data/network_sequence.conf");
+    const char* files[] = { "data/sequence.gph", "data/sequence.gph" };
+    DataSet ds;
+    add_instances(ds, files, 2);
+    Model* model = Model::factory();
+    model->saveParameters("initial.net");
+    delete model;
+    vector<double> expected = updated_weights("initial.net", ds);
+
+    // packed sequences, one time step after the other
+    Options::instance()->folding_schedule(LEVEL_SCHEDULE);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+    Options::instance()->num_threads(2);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+
+    remove("initial.net");
+  }
+
+  SECTION("Grids") {
+    configure("data/network_grid.conf");
+    // grids of different shapes in the same batch
+    const char* files[] = { "data/grid.gph", "data/grid_3x4.gph" };
+    DataSet ds;
+    add_instances(ds, files, 2);
+    Model* model = Model::factory();
+    model->saveParameters("initial.net");
+    delete model;
+    vector<double> expected = updated_weights("initial.net", ds);
+
+    // wavefronts of the implicit topology, the
+    // orientations concurrent with more threads
+    Options::instance()->folding_schedule(LEVEL_SCHEDULE);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+    Options::instance()->num_threads(4);
+    check_same_weights(updated_weights("initial.net", ds), expected);
+
+    remove("initial.net");
+  }
+}
+
+TEST_CASE("Gradient of the loss", "[network]") {
+  // backpropagation against central differences of the loss
+  // (see RecursiveNN::computeLoss) for each weight: after a plain
+  // gradient descent step with unit learning rate, the gradient
+  // is the difference between the initial and the updated weights.
+  // Outputs are compared with the targets in single precision: the
+  // step and the tolerance are large enough for the rounding errors
+  typedef RecursiveNN<TanH, Linear, GradientDescent, double, double> Network;
+  const char* confs[] = { "data/network_doag.conf", "data/network_ug.conf" };
+  const double h = 1e-3;
+
+  for(int c=0; c<2; ++c) {
+    configure(confs[c]);
+    Options::instance()->folding_schedule(LEVEL_SCHEDULE);
+    DataSet* ds;
+    if(c) {
+      // an undirected graph
+      const char* files[] = { "data/dpag.gph" };
+      ds = new DataSet;
+      add_instances(*ds, files, 1);
+    } else
+      ds = new DataSet("data/dataset.gph");
+
+    Network* network = new Network();
+    network->saveParameters("initial.net");
+    network->accumulateGradient(ds->begin(), ds->end());
+    network->adjustWeights(1.);
+    network->saveParameters("updated.net");
+    delete network;
+
+    string header;
+    vector<double> w = read_weights("initial.net", header);
+    vector<double> updated = read_weights("updated.net");
+    REQUIRE(updated.size() == w.size());
+
+    for(uint p=0; p<w.size(); ++p) {
+      double loss[2];
+      for(int s=0; s<2; ++s) {
+	vector<double> perturbed = w;
+	perturbed[p] += s?-h:h;
+	write_weights("perturbed.net", header, perturbed);
+	network = new Network("perturbed.net");
+	loss[s] = network->computeLoss(ds);
+	delete network;
+      }
+
+      CHECK((loss[0] - loss[1]) / (2*h) == Approx(w[p] - updated[p]).epsilon(1e-3).scale(1));
+    }
+
+    remove("initial.net");
+    remove("updated.net");
+    remove("perturbed.net");
+    delete ds;
+  }
+}
@@ -58,6 +58,14 @@ TEST_CASE("Basic tests", "[options]") {
   // now point to an existing but incorrect file
   argv[2] = (char*)"data/bad_rnn.conf";
   CHECK_THROWS(Options::instance()->parse_args(argc, argv));
+
+  // asynchronous training only with the rule of (momentum) gradient descent
+  argv[2] = (char*)"data/bad_async_rnn.conf";
+  CHECK_THROWS(Options::instance()->parse_args(argc-1, argv));
+
+  // the output unit major copy of the weights only with the node schedule
+  argv[2] = (char*)"data/bad_layout_rnn.conf";
+  CHECK_THROWS(Options::instance()->parse_args(argc-1, argv));
   
   // now point to an existing correct file and check it's read correctly
   argv[2] = (char*)"data/rnn.conf";
@@ -81,7 +89,10 @@ TEST_CASE("Basic tests", "[options]") {
   					       "       --training-set <training set file> [REQUIRED]\n"
   					       "       --test-set  <test set file> [OPTIONAL]\n"
   					       "       --validation-set <validation set file> [OPTIONAL]\n"
-  					       "       --threshold-error <threshold error to be used to stop training> (default is 1e-3)\n"));
+  					       "       --threshold-error <threshold error to be used to stop training> (default is 1e-3)\n"
+  					       "       --batch-size <number of instances between weight updates> (default is the whole training set)\n"
+  					       "       --batch-nodes <number of nodes between weight updates> (default is no limit)\n"
+  					       "       --seed <seed of the shuffling of the instances before each epoch of mini-batches> (default is random)\n"));
   // check values read from configuration file
   CHECK(Options::instance()->domain() == SEQUENCE);
   CHECK(Options::instance()->transduction() == IO_ISOMORPH);
@@ -93,6 +104,21 @@ TEST_CASE("Basic tests", "[options]") {
   vector<int> lnu = Options::instance()->layers_number_units();
   CHECK(lnu.size() == li.first + li.second);
   CHECK(lnu[0] == 10); CHECK(lnu[1] == 5); CHECK(lnu[2] == 5);
+  CHECK(Options::instance()->weights_layout() == OUTPUT_MAJOR);
+  CHECK(Options::instance()->numeric_precision() == DOUBLE_PRECISION);
+  CHECK(Options::instance()->folding_schedule() == NODE_SCHEDULE);
+  CHECK(Options::instance()->orientation_schedule() == CONCURRENT_ORIENTATIONS);
+  CHECK(Options::instance()->instruction_set() == SSE_ISA);
+  CHECK(Options::instance()->num_threads() == 2);
+  CHECK(Options::instance()->parallel_training() == SYNCHRONOUS_TRAINING);
+  CHECK(Options::instance()->optimizer() == ADAM);
+  CHECK(Options::instance()->beta1() == .9);
+  CHECK(Options::instance()->beta2() == .99);
+  CHECK(Options::instance()->lbfgs_memory() == 5);
+  CHECK(Options::instance()->learning_rate_schedule() == PLATEAU_LR);
+  CHECK(Options::instance()->learning_rate_decay() == .5);
+  CHECK(Options::instance()->learning_rate_step() == 3);
+  CHECK(Options::instance()->orientations_memory() == 64);
 
   // check application specific configuration values
   CHECK(atof(Options::instance()->get_parameter("eta").c_str()) == 1e-2);
@@ -103,4 +129,6 @@ TEST_CASE("Basic tests", "[options]") {
   CHECK(atoi(Options::instance()->get_parameter("onlinelearning").c_str()) == 1);
   CHECK(atoi(Options::instance()->get_parameter("random_net").c_str()) == 1);
   CHECK(atof(Options::instance()->get_parameter("threshold_error").c_str()) == 1e-3);
+  CHECK(atoi(Options::instance()->get_parameter("batch_size").c_str()) == 0);
+  CHECK(atoi(Options::instance()->get_parameter("batch_nodes").c_str()) == 0);
 }
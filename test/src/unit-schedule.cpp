@@ -0,0 +1,97 @@
+/*
+ * Recursive Neural Networks: neural networks for data structures 
+ *
+ * Copyright (C) 2018 Alessandro Vullo 
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+*/
+
+
+#include "catch.hpp"
+
+#include "Options.h"
+#include "LearningRateSchedule.h"
+using namespace std;
+
+
+TEST_CASE("Learning rate schedules", "[schedule]") {
+  // learning_rate_step 3 and the default learning_rate_decay (.5)
+  setenv("RNNOPTIONTYPE", "train", 1);
+  char* argv[] = { (char*)"dummy", (char*)"-c", (char*)"data/rnn.conf" };
+  Options::instance()->parse_args(3, argv);
+
+  double alpha = .9;
+  bool restore = false;
+
+  SECTION("constant") {
+    LearningRateSchedule* s = LearningRateSchedule::factory(CONSTANT_LR, .1, 10);
+    CHECK(s->update(1, 1., alpha, restore) == .1);
+    CHECK(s->update(9, 2., alpha, restore) == .1);
+    CHECK(!s->rollback());
+    delete s;
+  }
+
+  SECTION("step") {
+    LearningRateSchedule* s = LearningRateSchedule::factory(STEP_LR, .1, 10);
+    CHECK(s->update(2, 1., alpha, restore) == Approx(.1));
+    CHECK(s->update(3, 1., alpha, restore) == Approx(.05));
+    CHECK(s->update(6, 1., alpha, restore) == Approx(.025));
+    delete s;
+  }
+
+  SECTION("exponential") {
+    LearningRateSchedule* s = LearningRateSchedule::factory(EXPONENTIAL_LR, .1, 10);
+    CHECK(s->update(1, 1., alpha, restore) == Approx(.05));
+    CHECK(s->update(2, 1., alpha, restore) == Approx(.025));
+    delete s;
+  }
+
+  SECTION("cosine") {
+    LearningRateSchedule* s = LearningRateSchedule::factory(COSINE_LR, .1, 10);
+    CHECK(s->update(5, 1., alpha, restore) == Approx(.05));
+    CHECK(s->update(10, 1., alpha, restore) == Approx(0));
+    delete s;
+  }
+
+  SECTION("Vogl") {
+    LearningRateSchedule* s = LearningRateSchedule::factory(VOGL_LR, .1, 10);
+    CHECK(s->rollback());
+    // the error decreases: accelerate
+    CHECK(s->update(1, 1., alpha, restore) == Approx(.101));
+    CHECK(alpha == Approx(.1));
+    CHECK(!restore);
+    // it grows by more than 1%: slow down and restore the weights
+    CHECK(s->update(2, 2., alpha, restore) == Approx(.0505));
+    CHECK(alpha == 0);
+    CHECK(restore);
+    delete s;
+  }
+
+  SECTION("plateau") {
+    LearningRateSchedule* s = LearningRateSchedule::factory(PLATEAU_LR, .1, 10);
+    CHECK(s->update(1, 1., alpha, restore) == .1);
+    CHECK(s->update(2, .5, alpha, restore) == .1);
+    CHECK(s->update(3, .5, alpha, restore) == .1);
+    CHECK(s->update(4, .6, alpha, restore) == .1);
+    // no improvement for three epochs
+    CHECK(s->update(5, .5, alpha, restore) == Approx(.05));
+    CHECK(s->update(6, .4, alpha, restore) == Approx(.05));
+    delete s;
+  }
+}